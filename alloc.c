@@ -0,0 +1,243 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "alloc.h"
+#include "common.h"
+
+
+/*--------------- INTERNAL FUNCTIONS ---------------*/
+size_t _emi_alloc_round(size_t bytes) {
+    /* rounds up to the alignment. Has to be checked for overflow before */
+    return (bytes + ALLOC_ALIGNMENT - 1) & ~((size_t) ALLOC_ALIGNMENT - 1);
+}
+
+
+_EmiArenaBlock *_emi_arena_newBlock(Arena *arena, size_t bytes) {
+    size_t size = bytes > arena->block_size ? bytes : arena->block_size;
+    if(size > SIZE_MAX - sizeof(_EmiArenaBlock)) return NULL;
+    _EmiArenaBlock *block = (_EmiArenaBlock*) malloc (sizeof(_EmiArenaBlock) + size);
+    if(block == NULL) return NULL;
+    block->next = arena->blocks;
+    block->size = size;
+    block->used = 0;
+    arena->blocks = block;
+    return block;
+}
+
+void *_emi_arena_alloc(void *context, size_t bytes) {
+    Arena *arena = (Arena*) context;
+    if(bytes > SIZE_MAX - ALLOC_ALIGNMENT) return NULL;
+    bytes = _emi_alloc_round(bytes);
+
+    _EmiArenaBlock *block = arena->blocks;
+    if(block == NULL || block->size - block->used < bytes) {
+        block = _emi_arena_newBlock(arena, bytes);
+        if(block == NULL) return NULL;
+    }
+    arena->last = block->data + block->used;
+    block->used += bytes;
+    return arena->last;
+}
+
+void *_emi_arena_realloc(void *context, void *pointer, size_t old_bytes, size_t new_bytes) {
+    /* the last allocation just moves the end of its block, as long as it
+    fits. Anything else gets copied, and the old one stays until the reset */
+    Arena *arena = (Arena*) context;
+    if(pointer == NULL) return _emi_arena_alloc(context, new_bytes);
+
+    if(pointer == arena->last && new_bytes <= SIZE_MAX - ALLOC_ALIGNMENT) {
+        _EmiArenaBlock *block = arena->blocks;
+        size_t offset = (size_t) ((char*) pointer - block->data);
+        size_t rounded = _emi_alloc_round(new_bytes);
+        if(rounded <= block->size - offset) {
+            block->used = offset + rounded;
+            return pointer;
+        }
+    }
+    if(new_bytes <= old_bytes) return pointer;
+
+    void *new_pointer = _emi_arena_alloc(context, new_bytes);
+    if(new_pointer == NULL) return NULL;
+    memcpy(new_pointer, pointer, old_bytes);
+    return new_pointer;
+}
+
+void _emi_arena_free(void *context, void *pointer, size_t bytes) {
+    /* only the last allocation can be given back, everything else has to
+    wait for the reset */
+    (void) bytes;
+    Arena *arena = (Arena*) context;
+    if(pointer == NULL || pointer != arena->last) return;
+    arena->blocks->used = (size_t) ((char*) pointer - arena->blocks->data);
+    arena->last = NULL;
+}
+
+
+void *_emi_blockpool_alloc(void *context, size_t bytes) {
+    Blockpool *blockpool = (Blockpool*) context;
+    if(bytes > blockpool->block_size) {
+        printf("a blockpool can't give %zu bytes, its blocks are only %zu\n", bytes, blockpool->block_size);
+        return NULL;
+    }
+    if(blockpool->free_blocks != NULL) {
+        void *block = blockpool->free_blocks;
+        blockpool->free_blocks = *(void**) block;
+        return block;
+    }
+    if(blockpool->fresh == 0) {
+        _EmiBlockpoolChunk *chunk = (_EmiBlockpoolChunk*) malloc (sizeof(_EmiBlockpoolChunk) + blockpool->block_size * blockpool->blocks_per_chunk);
+        if(chunk == NULL) return NULL;
+        chunk->next = blockpool->chunks;
+        blockpool->chunks = chunk;
+        blockpool->fresh = blockpool->blocks_per_chunk;
+    }
+    ptrdiff_t index = blockpool->blocks_per_chunk - blockpool->fresh;
+    blockpool->fresh--;
+    return blockpool->chunks->data + index * blockpool->block_size;
+}
+
+void *_emi_blockpool_realloc(void *context, void *pointer, size_t old_bytes, size_t new_bytes) {
+    /* every block is already as big as it gets */
+    (void) old_bytes;
+    Blockpool *blockpool = (Blockpool*) context;
+    if(pointer == NULL) return _emi_blockpool_alloc(context, new_bytes);
+    if(new_bytes > blockpool->block_size) {
+        printf("a blockpool can't give %zu bytes, its blocks are only %zu\n", new_bytes, blockpool->block_size);
+        return NULL;
+    }
+    return pointer;
+}
+
+void _emi_blockpool_free(void *context, void *pointer, size_t bytes) {
+    (void) bytes;
+    Blockpool *blockpool = (Blockpool*) context;
+    if(pointer == NULL) return;
+    *(void**) pointer = blockpool->free_blocks;
+    blockpool->free_blocks = pointer;
+}
+
+
+
+
+
+
+/*--------------- ARENA FUNCTIONS ---------------*/
+Arena *emi_arena_create(size_t block_size) {
+    /* 0 gives the default block size */
+    if(block_size == 0) block_size = DEFAULT_ARENA_BLOCK_SIZE;
+    if(block_size > SIZE_MAX - ALLOC_ALIGNMENT) {
+        printf("an arena can't have blocks of %zu bytes\n", block_size);
+        return NULL;
+    }
+    Arena *arena = (Arena*) malloc (sizeof(Arena));
+    if(arena == NULL) {
+        printf("malloc failed in emi_arena_create :(\n");
+        return NULL;
+    }
+    arena->allocator.alloc   = _emi_arena_alloc;
+    arena->allocator.realloc = _emi_arena_realloc;
+    arena->allocator.free    = _emi_arena_free;
+    arena->allocator.context = arena;
+    arena->block_size        = _emi_alloc_round(block_size);
+    arena->blocks            = NULL;
+    arena->last              = NULL;
+    return arena;
+}
+
+EmiAllocator *emi_arena_allocator(Arena *arena) {
+    return &arena->allocator;
+}
+
+size_t emi_arena_used(Arena *arena) {
+    size_t used = 0;
+    for(_EmiArenaBlock *block = arena->blocks; block != NULL; block = block->next)
+        used += block->used;
+    return used;
+}
+
+void emi_arena_reset(Arena *arena) {
+    /* the oldest block is kept, so it doesn't have to be malloc'd again */
+    _EmiArenaBlock *block = arena->blocks;
+    if(block == NULL) return;
+    while(block->next != NULL) {
+        _EmiArenaBlock *next = block->next;
+        free(block);
+        block = next;
+    }
+    block->used = 0;
+    arena->blocks = block;
+    arena->last = NULL;
+    return;
+}
+
+void emi_arena_free(Arena *arena) {
+    _EmiArenaBlock *block = arena->blocks;
+    while(block != NULL) {
+        _EmiArenaBlock *next = block->next;
+        free(block);
+        block = next;
+    }
+    free(arena);
+    return;
+}
+
+
+/*--------------- BLOCKPOOL FUNCTIONS ---------------*/
+Blockpool *emi_blockpool_create(size_t block_size, ptrdiff_t blocks_per_chunk) {
+    /* a block has to fit a pointer, for the list of free blocks. 0 blocks
+    per chunk gives the default */
+    if(block_size < sizeof(void*)) block_size = sizeof(void*);
+    if(blocks_per_chunk <= 0) blocks_per_chunk = DEFAULT_BLOCKPOOL_BLOCKS;
+    if(block_size > SIZE_MAX - ALLOC_ALIGNMENT
+    || _emi_alloc_round(block_size) > (SIZE_MAX - sizeof(_EmiBlockpoolChunk)) / (size_t) blocks_per_chunk) {
+        printf("a blockpool can't have %td blocks of %zu bytes in a chunk\n", blocks_per_chunk, block_size);
+        return NULL;
+    }
+    Blockpool *blockpool = (Blockpool*) malloc (sizeof(Blockpool));
+    if(blockpool == NULL) {
+        printf("malloc failed in emi_blockpool_create :(\n");
+        return NULL;
+    }
+    blockpool->allocator.alloc   = _emi_blockpool_alloc;
+    blockpool->allocator.realloc = _emi_blockpool_realloc;
+    blockpool->allocator.free    = _emi_blockpool_free;
+    blockpool->allocator.context = blockpool;
+    blockpool->block_size        = _emi_alloc_round(block_size);
+    blockpool->blocks_per_chunk  = blocks_per_chunk;
+    blockpool->chunks            = NULL;
+    blockpool->fresh             = 0;
+    blockpool->free_blocks       = NULL;
+    return blockpool;
+}
+
+EmiAllocator *emi_blockpool_allocator(Blockpool *blockpool) {
+    return &blockpool->allocator;
+}
+
+void emi_blockpool_reset(Blockpool *blockpool) {
+    /* keeps the oldest chunk, with every block fresh again */
+    _EmiBlockpoolChunk *chunk = blockpool->chunks;
+    if(chunk == NULL) return;
+    while(chunk->next != NULL) {
+        _EmiBlockpoolChunk *next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    blockpool->chunks = chunk;
+    blockpool->fresh = blockpool->blocks_per_chunk;
+    blockpool->free_blocks = NULL;
+    return;
+}
+
+void emi_blockpool_free(Blockpool *blockpool) {
+    _EmiBlockpoolChunk *chunk = blockpool->chunks;
+    while(chunk != NULL) {
+        _EmiBlockpoolChunk *next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    free(blockpool);
+    return;
+}
@@ -0,0 +1,93 @@
+/* allocators for the dlists and dstacks, so a lot of short lived
+containers don't all have to go through malloc
+
+  ____
+ /    \
+| _  _ |
+|      |
+ \    /
+  \  /
+   \/
+
+
+
+an arena just bumps a pointer through big blocks. Freeing something does
+nothing (unless it was the last thing allocated), but the whole arena can
+be reset at once, which throws away everything made with it. So all the
+containers of something like a request can be made with one arena, and
+be gone with a single emi_arena_reset, without freeing them one by one.
+
+a blockpool hands out blocks that are all the same size, and keeps the
+freed ones in a list to give out again. Anything bigger than a block
+fails, so it's for containers that are known to stay small.
+
+neither is thread safe, and both have to outlive everything made with them.
+With EMI_STATS the stats of a container are still malloc'd, so those are
+only given back by freeing the container.
+*/
+
+
+
+#ifndef ALLOC_H
+#define ALLOC_H
+
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "common.h"
+
+
+/*--------------- DEFINES ---------------*/
+#define ALLOC_ALIGNMENT 16 /* everything either of them gives out is aligned to this */
+#define DEFAULT_ARENA_BLOCK_SIZE ((size_t) 64 << 10)
+#define DEFAULT_BLOCKPOOL_BLOCKS 64 /* blocks per chunk of a blockpool */
+
+
+/*--------------- STRUCTS ---------------*/
+typedef struct _EmiArenaBlock {
+    struct _EmiArenaBlock *next; /* the one made before it */
+    size_t size;
+    size_t used;
+    _Alignas(ALLOC_ALIGNMENT) char data[];
+} _EmiArenaBlock;
+
+typedef struct Arena {
+    EmiAllocator allocator; /* what gets given to the create functions */
+    size_t block_size;
+    _EmiArenaBlock *blocks; /* the newest first, which is the one allocated from */
+    char *last; /* the last allocation, the only one that can grow in place */
+} Arena;
+
+typedef struct _EmiBlockpoolChunk {
+    struct _EmiBlockpoolChunk *next;
+    _Alignas(ALLOC_ALIGNMENT) char data[];
+} _EmiBlockpoolChunk;
+
+typedef struct Blockpool {
+    EmiAllocator allocator; /* same here */
+    size_t block_size;
+    ptrdiff_t blocks_per_chunk;
+    _EmiBlockpoolChunk *chunks; /* the newest first */
+    ptrdiff_t fresh; /* blocks of the newest chunk that were never given out */
+    void *free_blocks; /* a list through the freed blocks themselves */
+} Blockpool;
+
+/*--------------- ENUMS ---------------*/
+
+
+
+
+/*--------------- ARENA FUNCTIONS ---------------*/
+Arena        *emi_arena_create      (size_t block_size); /* allocations bigger than block_size get a block of their own */
+EmiAllocator *emi_arena_allocator   (Arena *arena);
+size_t        emi_arena_used        (Arena *arena); /* bytes given out since the last reset */
+void          emi_arena_reset       (Arena *arena); /* everything made with it is gone, but it keeps one block */
+void          emi_arena_free        (Arena *arena);
+
+/*--------------- BLOCKPOOL FUNCTIONS ---------------*/
+Blockpool    *emi_blockpool_create    (size_t block_size, ptrdiff_t blocks_per_chunk);
+EmiAllocator *emi_blockpool_allocator (Blockpool *blockpool);
+void          emi_blockpool_reset     (Blockpool *blockpool); /* same as for the arena */
+void          emi_blockpool_free      (Blockpool *blockpool);
+
+#endif
@@ -0,0 +1,924 @@
+/* benchmarks for every dlist and dstack function
+
+run it with make bench, which writes the results to bench/results.csv.
+Every line is one function on one element size and dlist size:
+
+version,function,workload,data_size,size,ops,ns_per_op,allocs_per_op
+
+allocs_per_op counts malloc, calloc, realloc and aligned_alloc calls,
+which only works when it's linked with the --wrap flags from the
+Makefile (otherwise it's -1). Functions that take linear time per call
+(like insert at a random index) only get called QUADRATIC_OPS times, so
+the big sizes don't take forever
+
+arguments: bench [max_size] [max_bytes] [only functions containing this]
+sizes go from 10 up to max_size, but a dlist is never bigger than
+max_bytes, so the 64 byte elements stop earlier
+*/
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "dlist.h"
+#include "dstack.h"
+#include "pool.h"
+#include "alloc.h"
+
+
+/*--------------- DEFINES ---------------*/
+#define QUADRATIC_OPS 1000    /* calls to the functions that are linear per call */
+#define CONSTANT_OPS 100000   /* calls to the functions that are constant per call */
+#define INDEX_COUNT 65536     /* random indices that are made before timing */
+#define BENCH_MIN_NS 10000000 /* a function is repeated until it took this long */
+#define BENCH_MAX_RUNS 1000
+#ifndef BENCH_VERSION
+#define BENCH_VERSION "unknown"
+#endif
+
+
+
+
+/*--------------- COUNTING ALLOCATIONS ---------------*/
+static long allocations = 0;
+
+#ifdef BENCH_COUNT_ALLOCATIONS
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *pointer, size_t size);
+void *__real_aligned_alloc(size_t alignment, size_t size);
+
+void *__wrap_malloc(size_t size) {
+    allocations++;
+    return __real_malloc(size);
+}
+void *__wrap_calloc(size_t count, size_t size) {
+    allocations++;
+    return __real_calloc(count, size);
+}
+void *__wrap_realloc(void *pointer, size_t size) {
+    allocations++;
+    return __real_realloc(pointer, size);
+}
+void *__wrap_aligned_alloc(size_t alignment, size_t size) {
+    allocations++;
+    return __real_aligned_alloc(alignment, size);
+}
+#endif
+
+
+
+
+/*--------------- TIMING ---------------*/
+static long long total_ns, total_ops, total_allocations;
+static long long start_ns, start_allocations;
+static volatile long sink; /* so the compiler doesn't throw away what we time */
+
+static long long now(void) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (long long) time.tv_sec * 1000000000 + time.tv_nsec;
+}
+
+static void start(void) {
+    start_allocations = allocations;
+    start_ns = now();
+}
+
+static void stop(long ops) {
+    total_ns          += now() - start_ns;
+    total_allocations += allocations - start_allocations;
+    total_ops         += ops;
+}
+
+
+
+
+/*--------------- THE DATA ---------------*/
+typedef struct {
+    int    data_size;
+    int    data_type;
+    long   size;
+    Dlist *list;      /* random elements */
+    Dlist *sorted;    /* the same, sorted by benchOrder */
+    Dlist *eytzinger; /* sorted, in eytzinger layout */
+    char  *array;     /* the same as list, as a normal array */
+    int   *indices;   /* random indices into list */
+    char   path[64];  /* a file with list saved in it */
+    Pool  *pool;
+} Bench;
+
+static int data_size; /* for the callbacks, which don't get it */
+
+static int benchOrder(void *a, void *b) {
+    int difference = memcmp(a, b, data_size);
+    return difference < 0 ? 1 : difference > 0 ? -1 : 0;
+}
+static void benchMap(void *in, void *out) {
+    memcpy(out, in, data_size);
+    ((unsigned char*) out)[0] ^= 1;
+}
+static void benchMapBlock(void *in, void *out, int count) {
+    memcpy(out, in, (size_t) count * data_size);
+    for(int i=0; i<count; i++) ((unsigned char*) out)[i * data_size] ^= 1;
+}
+static void benchReduce(void *in, void *output) {
+    *(long*) output += *(unsigned char*) in;
+}
+static void benchReduceBlock(void *in, int count, void *output) {
+    long sum = 0;
+    for(int i=0; i<count; i++) sum += ((unsigned char*) in)[i * data_size];
+    *(long*) output += sum;
+}
+static void benchCombine(void *partial, void *output) {
+    *(long*) output += *(long*) partial;
+}
+static bool benchOdd(void *element) {
+    return *(unsigned char*) element & 1;
+}
+static void benchOddBlock(void *in, bool *keep, int count) {
+    for(int i=0; i<count; i++) keep[i] = ((unsigned char*) in)[i * data_size] & 1;
+}
+static bool benchNever(void *element) {
+    (void) element;
+    return false;
+}
+
+static long capped(Bench *b, long ops) {
+    return b->size < ops ? b->size : ops;
+}
+static int randomIndex(Bench *b, long i) {
+    return b->indices[i % INDEX_COUNT];
+}
+static char *element(Bench *b, long i) {
+    return b->array + (long) randomIndex(b, i) * b->data_size;
+}
+
+static Bench *benchCreate(int element_size, long size, Pool *pool) {
+    Bench *b = (Bench*) calloc (1, sizeof(Bench));
+    b->data_size = element_size;
+    b->data_type = element_size == 1 ? DATA_TYPE_CHAR : DATA_TYPE_INT;
+    b->size      = size;
+    b->pool      = pool;
+
+    /* about as many different values as elements, so there are some
+    duplicates. Chars stay printable */
+    b->array = (char*) malloc (size * element_size);
+    for(long i=0; i<size; i++) {
+        char *item = b->array + i * element_size;
+        if(element_size == 1) {
+            *item = 'a' + rand() % 26;
+        } else {
+            for(int j=0; j<element_size; j++) item[j] = rand();
+            int value = rand() % size;
+            memcpy(item, &value, sizeof(int));
+        }
+    }
+    b->indices = (int*) malloc (INDEX_COUNT * sizeof(int));
+    for(int i=0; i<INDEX_COUNT; i++) b->indices[i] = rand() % size;
+
+    data_size    = element_size;
+    b->list      = emi_dlist_createFromArray(b->array, size, element_size, b->data_type);
+    b->sorted    = emi_dlist_createCopy(b->list);
+    emi_dlist_stableSortByOrder(b->sorted, benchOrder);
+    b->eytzinger = emi_dlist_createEytzinger(b->sorted);
+
+    snprintf(b->path, sizeof(b->path), "/tmp/emidata_bench_%d.bin", (int) getpid());
+    FILE *file = fopen(b->path, "wb");
+    emi_dlist_save(b->list, file);
+    fclose(file);
+    return b;
+}
+
+static void benchFree(Bench *b) {
+    unlink(b->path);
+    emi_dlist_free(b->list);
+    emi_dlist_free(b->sorted);
+    emi_dlist_free(b->eytzinger);
+    free(b->array);
+    free(b->indices);
+    free(b);
+}
+
+static Dstack *stackCopy(Bench *b) {
+    return emi_dstack_createFromArray(b->array, b->size, b->data_size, b->data_type);
+}
+
+/* the print functions write to /dev/null while they're timed */
+static int saved_stdout;
+static void quiet(void) {
+    fflush(stdout);
+    saved_stdout = dup(1);
+    int null = open("/dev/null", O_WRONLY);
+    dup2(null, 1);
+    close(null);
+}
+static void loud(void) {
+    fflush(stdout);
+    dup2(saved_stdout, 1);
+    close(saved_stdout);
+}
+
+
+
+
+/*--------------- DLIST CREATION ---------------*/
+static void bench_create(Bench *b) {
+    start();
+    for(int i=0; i<QUADRATIC_OPS; i++) emi_dlist_free(emi_dlist_create(b->data_size, b->data_type));
+    stop(QUADRATIC_OPS);
+}
+static void bench_createWithParas(Bench *b) {
+    start();
+    for(int i=0; i<QUADRATIC_OPS; i++) emi_dlist_free(emi_dlist_createWithParas(b->data_size, b->data_type, b->size, DEFAULT_GROWTH_EXPONENTIAL));
+    stop(QUADRATIC_OPS);
+}
+static void bench_createWithAllocator(Bench *b) {
+    /* a scratch dlist per op, all of it thrown away with a reset */
+    Arena *arena = emi_arena_create(0);
+    start();
+    for(int i=0; i<QUADRATIC_OPS; i++) {
+        emi_dlist_createWithAllocator(b->data_size, b->data_type, DEFAULT_INITIAL_SIZE, DEFAULT_GROWTH_EXPONENTIAL, emi_arena_allocator(arena));
+        emi_arena_reset(arena);
+    }
+    stop(QUADRATIC_OPS);
+    emi_arena_free(arena);
+}
+static void bench_createFromArray(Bench *b) {
+    start();
+    Dlist *d = emi_dlist_createFromArray(b->array, b->size, b->data_size, b->data_type);
+    stop(1);
+    emi_dlist_free(d);
+}
+static void bench_createCopy(Bench *b) {
+    start();
+    Dlist *d = emi_dlist_createCopy(b->list);
+    stop(1);
+    emi_dlist_free(d);
+}
+static void bench_createSublist(Bench *b) {
+    start();
+    Dlist *d = emi_dlist_createSublist(b->list, 0, b->size / 2);
+    stop(1);
+    emi_dlist_free(d);
+}
+static void bench_createFromView(Bench *b) {
+    start();
+    Dlist *d = emi_dlist_createFromView(emi_dlist_viewSlice(emi_dlist_view(b->list), 0, b->size, 2));
+    stop(1);
+    emi_dlist_free(d);
+}
+static void bench_setCopyOnWrite(Bench *b) {
+    /* a copy that shares the data, and then the copy the first write makes */
+    Dlist *d = emi_dlist_createCopy(b->list);
+    emi_dlist_setCopyOnWrite(d, true);
+    start();
+    Dlist *e = emi_dlist_createCopy(d);
+    emi_dlist_set(e, b->array, 0);
+    stop(1);
+    emi_dlist_free(e);
+    emi_dlist_free(d);
+}
+static void bench_createSplit(Bench *b) {
+    Dlist *d = emi_dlist_createCopy(b->list);
+    start();
+    Dlist *e = emi_dlist_createSplit(d, b->size / 2);
+    stop(1);
+    emi_dlist_free(d);
+    emi_dlist_free(e);
+}
+
+
+/*--------------- DLIST MAPPED AND SAVED ---------------*/
+static void bench_openMapped(Bench *b) {
+    /* opening and closing again, reading the pages is up to whoever uses it */
+    start();
+    Dlist *d = emi_dlist_openMapped(b->path, b->data_size, b->data_type, MAPPED_READONLY);
+    emi_dlist_close(d);
+    stop(1);
+}
+static void bench_sync(Bench *b) {
+    Dlist *d = emi_dlist_openMapped(b->path, b->data_size, b->data_type, 0);
+    emi_dlist_set(d, b->array, 0);
+    start();
+    emi_dlist_sync(d);
+    stop(1);
+    emi_dlist_free(d);
+}
+static void bench_close(Bench *b) {
+    Dlist *d = emi_dlist_openMapped(b->path, b->data_size, b->data_type, 0);
+    start();
+    emi_dlist_close(d);
+    stop(1);
+}
+static void bench_save(Bench *b) {
+    FILE *file = tmpfile();
+    start();
+    emi_dlist_save(b->list, file);
+    fflush(file);
+    stop(1);
+    fclose(file);
+}
+static void bench_load(Bench *b) {
+    FILE *file = fopen(b->path, "rb");
+    start();
+    Dlist *d = emi_dlist_load(file);
+    stop(1);
+    fclose(file);
+    emi_dlist_free(d);
+}
+static void bench_loadChunked(Bench *b) {
+    FILE *file = fopen(b->path, "rb");
+    Dlist *d = emi_dlist_create(b->data_size, b->data_type);
+    start();
+    emi_dlist_loadChunked(d, file, 0);
+    stop(1);
+    fclose(file);
+    emi_dlist_free(d);
+}
+
+
+/*--------------- DLIST READING ---------------*/
+static void bench_read(Bench *b) {
+    long ops = capped(b, CONSTANT_OPS);
+    start();
+    for(long i=0; i<ops; i++) free(emi_dlist_read(b->list, randomIndex(b, i)));
+    stop(ops);
+}
+static void bench_readRaw(Bench *b) {
+    long ops = capped(b, CONSTANT_OPS);
+    start();
+    for(long i=0; i<ops; i++) sink += *(char*) emi_dlist_readRaw(b->list, randomIndex(b, i));
+    stop(ops);
+}
+static void bench_readInto(Bench *b) {
+    long ops = capped(b, CONSTANT_OPS);
+    char output[b->data_size];
+    start();
+    for(long i=0; i<ops; i++) emi_dlist_readInto(b->list, randomIndex(b, i), output);
+    stop(ops);
+    sink += output[0];
+}
+
+
+/*--------------- DLIST MODIFICATION ---------------*/
+static void bench_append(Bench *b) {
+    /* the append heavy workload: building the whole dlist one by one */
+    Dlist *d = emi_dlist_create(b->data_size, b->data_type);
+    start();
+    for(long i=0; i<b->size; i++) emi_dlist_append(d, b->array + i * b->data_size);
+    stop(b->size);
+    emi_dlist_free(d);
+}
+static void bench_createHuge(Bench *b) {
+    /* the same as append, but everything above a MB grows by remapping */
+    Dlist *d = emi_dlist_createHuge(b->data_size, b->data_type, DEFAULT_INITIAL_SIZE, DEFAULT_GROWTH_EXPONENTIAL, (size_t) 1 << 20);
+    start();
+    for(long i=0; i<b->size; i++) emi_dlist_append(d, b->array + i * b->data_size);
+    stop(b->size);
+    emi_dlist_free(d);
+}
+static void bench_prepend(Bench *b) {
+    Dlist *d = emi_dlist_createCopy(b->list);
+    long ops = capped(b, QUADRATIC_OPS);
+    start();
+    for(long i=0; i<ops; i++) emi_dlist_prepend(d, element(b, i));
+    stop(ops);
+    emi_dlist_free(d);
+}
+static void bench_insert(Bench *b) {
+    /* the random insert workload */
+    Dlist *d = emi_dlist_createCopy(b->list);
+    long ops = capped(b, QUADRATIC_OPS);
+    start();
+    for(long i=0; i<ops; i++) emi_dlist_insert(d, element(b, i), randomIndex(b, i));
+    stop(ops);
+    emi_dlist_free(d);
+}
+static void bench_insertRange(Bench *b) {
+    Dlist *d = emi_dlist_createCopy(b->list);
+    long ops = capped(b, QUADRATIC_OPS);
+    int count = b->size < 8 ? b->size : 8;
+    start();
+    for(long i=0; i<ops; i++) emi_dlist_insertRange(d, b->array, count, randomIndex(b, i));
+    stop(ops);
+    emi_dlist_free(d);
+}
+static void bench_remove(Bench *b) {
+    Dlist *d = emi_dlist_createCopy(b->list);
+    long ops = capped(b, QUADRATIC_OPS) / 2;
+    start();
+    for(long i=0; i<ops; i++) emi_dlist_remove(d, randomIndex(b, i) % emi_dlist_size(d));
+    stop(ops);
+    emi_dlist_free(d);
+}
+static void bench_removeRange(Bench *b) {
+    Dlist *d = emi_dlist_createCopy(b->list);
+    long ops = capped(b, QUADRATIC_OPS) / 16 + 1; /* leaves at least 9 */
+    start();
+    for(long i=0; i<ops; i++) {
+        int start_index = randomIndex(b, i) % (emi_dlist_size(d) - 8);
+        emi_dlist_removeRange(d, start_index, start_index + 8);
+    }
+    stop(ops);
+    emi_dlist_free(d);
+}
+static void bench_pop(Bench *b) {
+    Dlist *d = emi_dlist_createCopy(b->list);
+    start();
+    for(long i=0; i<b->size; i++) free(emi_dlist_pop(d));
+    stop(b->size);
+    emi_dlist_free(d);
+}
+static void bench_popInto(Bench *b) {
+    Dlist *d = emi_dlist_createCopy(b->list);
+    char output[b->data_size];
+    start();
+    for(long i=0; i<b->size; i++) emi_dlist_popInto(d, output);
+    stop(b->size);
+    emi_dlist_free(d);
+}
+static void bench_set(Bench *b) {
+    long ops = capped(b, CONSTANT_OPS);
+    start();
+    for(long i=0; i<ops; i++) emi_dlist_set(b->list, element(b, i), randomIndex(b, i));
+    stop(ops);
+}
+static void bench_swap(Bench *b) {
+    long ops = capped(b, CONSTANT_OPS);
+    start();
+    for(long i=0; i<ops; i++) emi_dlist_swap(b->list, randomIndex(b, i), randomIndex(b, i + 1));
+    stop(ops);
+}
+static void bench_extendByArray(Bench *b) {
+    Dlist *d = emi_dlist_create(b->data_size, b->data_type);
+    start();
+    emi_dlist_extendByArray(d, b->array, b->size);
+    stop(1);
+    emi_dlist_free(d);
+}
+static void bench_extendByDlist(Bench *b) {
+    Dlist *d = emi_dlist_create(b->data_size, b->data_type);
+    start();
+    emi_dlist_extendByDlist(d, b->list);
+    stop(1);
+    emi_dlist_free(d);
+}
+
+
+/*--------------- DLIST ORDER CHANGING ---------------*/
+/* the sort workload. All of them sort a fresh copy of the random dlist */
+#define BENCH_WHOLE(name, call)                \
+static void bench_##name(Bench *b) {           \
+    Dlist *d = emi_dlist_createCopy(b->list);  \
+    start();                                   \
+    call;                                      \
+    stop(1);                                   \
+    emi_dlist_free(d);                         \
+}
+BENCH_WHOLE(randomizeOrder,     emi_dlist_randomizeOrder(d))
+BENCH_WHOLE(betterSort,         emi_dlist_betterSort(d))
+BENCH_WHOLE(betterSortByOrder,  emi_dlist_betterSortByOrder(d, benchOrder))
+BENCH_WHOLE(stableSort,         emi_dlist_stableSort(d))
+BENCH_WHOLE(stableSortByOrder,  emi_dlist_stableSortByOrder(d, benchOrder))
+BENCH_WHOLE(radixSort,          emi_dlist_radixSort(d))
+BENCH_WHOLE(parallelSort,       emi_dlist_parallelSort(d, benchOrder, emi_pool_threads(b->pool)))
+BENCH_WHOLE(bubbleSort,         emi_dlist_bubbleSort(d))
+BENCH_WHOLE(bubbleSortByOrder,  emi_dlist_bubbleSortByOrder(d, benchOrder))
+BENCH_WHOLE(reverse,            emi_dlist_reverse(d))
+BENCH_WHOLE(filter,             emi_dlist_filter(d, benchOdd))
+BENCH_WHOLE(filterBlock,        emi_dlist_filterBlock(d, benchOddBlock))
+BENCH_WHOLE(removeDuplicates,   emi_dlist_removeDuplicates(d))
+BENCH_WHOLE(map,                emi_dlist_map(d, benchMap))
+BENCH_WHOLE(mapBlock,           emi_dlist_mapBlock(d, benchMapBlock))
+BENCH_WHOLE(parallelMap,        emi_dlist_parallelMap(d, benchMap, b->pool))
+BENCH_WHOLE(clear,              emi_dlist_clear(d))
+BENCH_WHOLE(reserve,            emi_dlist_reserve(d, 2 * emi_dlist_size(d) + 1))
+BENCH_WHOLE(shrinkToFit,        emi_dlist_shrinkToFit(d))
+
+static void bench_free(Bench *b) {
+    Dlist *d = emi_dlist_createCopy(b->list);
+    start();
+    emi_dlist_free(d);
+    stop(1);
+}
+
+
+/*--------------- DLIST SEARCHING ---------------*/
+/* these scan from the start, so they're linear per call */
+static void bench_find(Bench *b) {
+    long ops = capped(b, QUADRATIC_OPS);
+    start();
+    for(long i=0; i<ops; i++) sink += emi_dlist_find(b->list, element(b, i));
+    stop(ops);
+}
+static void bench_count(Bench *b) {
+    long ops = capped(b, QUADRATIC_OPS);
+    start();
+    for(long i=0; i<ops; i++) sink += emi_dlist_count(b->list, element(b, i));
+    stop(ops);
+}
+static void bench_viewFind(Bench *b) {
+    /* every other element, so it can't use the SIMD search */
+    DlistView view = emi_dlist_viewSlice(emi_dlist_view(b->list), 0, b->size, 2);
+    long ops = capped(b, QUADRATIC_OPS);
+    start();
+    for(long i=0; i<ops; i++) sink += emi_dlist_viewFind(view, element(b, i));
+    stop(ops);
+}
+static void bench_findByCondition(Bench *b) {
+    long ops = capped(b, QUADRATIC_OPS);
+    start();
+    for(long i=0; i<ops; i++) sink += emi_dlist_findByCondition(b->list, benchNever);
+    stop(ops);
+}
+
+#define BENCH_NEW_DLIST(name, call)   \
+static void bench_##name(Bench *b) {  \
+    start();                          \
+    Dlist *d = call;                  \
+    stop(1);                          \
+    emi_dlist_free(d);                \
+}
+BENCH_NEW_DLIST(findAll,            emi_dlist_findAll(b->list, b->array))
+BENCH_NEW_DLIST(findAllByCondition, emi_dlist_findAllByCondition(b->list, benchOdd))
+BENCH_NEW_DLIST(mergeSorted,        emi_dlist_mergeSorted(b->sorted, b->sorted, benchOrder))
+BENCH_NEW_DLIST(createEytzinger,    emi_dlist_createEytzinger(b->sorted))
+BENCH_NEW_DLIST(uniqueElements,     emi_dlist_uniqueElements(b->list))
+BENCH_NEW_DLIST(intersection,       emi_dlist_intersection(b->list, b->sorted))
+BENCH_NEW_DLIST(union,              emi_dlist_union(b->list, b->sorted))
+BENCH_NEW_DLIST(viewIntersection,   emi_dlist_viewIntersection(emi_dlist_viewRange(b->list, 0, b->size / 2), emi_dlist_view(b->sorted)))
+
+
+/*--------------- DLIST SORTED ---------------*/
+#define BENCH_LOOKUP(name, call)                   \
+static void bench_##name(Bench *b) {               \
+    long ops = capped(b, CONSTANT_OPS);            \
+    start();                                       \
+    for(long i=0; i<ops; i++) sink += call;        \
+    stop(ops);                                     \
+}
+BENCH_LOOKUP(lowerBound,          emi_dlist_lowerBound(b->sorted, element(b, i), benchOrder))
+BENCH_LOOKUP(upperBound,          emi_dlist_upperBound(b->sorted, element(b, i), benchOrder))
+BENCH_LOOKUP(binarySearch,        emi_dlist_binarySearch(b->sorted, element(b, i), benchOrder))
+BENCH_LOOKUP(eytzingerLowerBound, emi_dlist_eytzingerLowerBound(b->eytzinger, element(b, i), benchOrder))
+BENCH_LOOKUP(eytzingerSearch,     emi_dlist_eytzingerSearch(b->eytzinger, element(b, i), benchOrder))
+BENCH_LOOKUP(viewLowerBound,      emi_dlist_viewLowerBound(emi_dlist_viewRange(b->sorted, 0, b->size / 2), element(b, i), benchOrder))
+
+static void bench_insertSorted(Bench *b) {
+    Dlist *d = emi_dlist_createCopy(b->sorted);
+    long ops = capped(b, QUADRATIC_OPS);
+    start();
+    for(long i=0; i<ops; i++) emi_dlist_insertSorted(d, element(b, i), benchOrder);
+    stop(ops);
+    emi_dlist_free(d);
+}
+
+
+/*--------------- DLIST COMPUTATIONAL ---------------*/
+static void bench_reduce(Bench *b) {
+    long output = 0;
+    start();
+    emi_dlist_reduce(b->list, benchReduce, &output);
+    stop(1);
+    sink += output;
+}
+static void bench_reduceBlock(Bench *b) {
+    long output = 0;
+    start();
+    emi_dlist_reduceBlock(b->list, benchReduceBlock, &output);
+    stop(1);
+    sink += output;
+}
+static void bench_parallelReduce(Bench *b) {
+    long output = 0, identity = 0;
+    start();
+    emi_dlist_parallelReduce(b->list, benchReduce, benchCombine, &identity, &output, sizeof(long), b->pool);
+    stop(1);
+    sink += output;
+}
+
+
+/*--------------- DLIST UTILITY ---------------*/
+BENCH_LOOKUP(size,     emi_dlist_size(b->list))
+BENCH_LOOKUP(dataSize, emi_dlist_dataSize(b->list))
+BENCH_LOOKUP(isEmpty,  emi_dlist_isEmpty(b->list))
+
+static void bench_print(Bench *b) {
+    quiet();
+    start();
+    emi_dlist_print(b->list);
+    stop(1);
+    loud();
+}
+static void bench_printString(Bench *b) {
+    quiet();
+    start();
+    emi_dlist_printString(b->list);
+    stop(1);
+    loud();
+}
+static void bench_sprintString(Bench *b) {
+    char *buffer = (char*) malloc (b->size + 1);
+    start();
+    emi_dlist_sprintString(buffer, b->list);
+    stop(1);
+    free(buffer);
+}
+
+
+
+
+/*--------------- DSTACK ---------------*/
+static void bench_stack_create(Bench *b) {
+    start();
+    for(int i=0; i<QUADRATIC_OPS; i++) emi_dstack_free(emi_dstack_create(b->data_size, b->data_type));
+    stop(QUADRATIC_OPS);
+}
+static void bench_stack_createWithAllocator(Bench *b) {
+    Arena *arena = emi_arena_create(0);
+    start();
+    for(int i=0; i<QUADRATIC_OPS; i++) {
+        emi_dstack_createWithAllocator(b->data_size, b->data_type, DEFAULT_INITIAL_SIZE, DEFAULT_GROWTH_EXPONENTIAL, emi_arena_allocator(arena));
+        emi_arena_reset(arena);
+    }
+    stop(QUADRATIC_OPS);
+    emi_arena_free(arena);
+}
+static void bench_stack_createWithParas(Bench *b) {
+    start();
+    for(int i=0; i<QUADRATIC_OPS; i++) emi_dstack_free(emi_dstack_createWithParas(b->data_size, b->data_type, b->size, DEFAULT_GROWTH_EXPONENTIAL));
+    stop(QUADRATIC_OPS);
+}
+static void bench_stack_createFromArray(Bench *b) {
+    start();
+    Dstack *s = stackCopy(b);
+    stop(1);
+    emi_dstack_free(s);
+}
+static void bench_stack_createCopy(Bench *b) {
+    Dstack *s = stackCopy(b);
+    start();
+    Dstack *t = emi_dstack_createCopy(s);
+    stop(1);
+    emi_dstack_free(s);
+    emi_dstack_free(t);
+}
+static void bench_stack_push(Bench *b) {
+    Dstack *s = emi_dstack_create(b->data_size, b->data_type);
+    start();
+    for(long i=0; i<b->size; i++) emi_dstack_push(s, b->array + i * b->data_size);
+    stop(b->size);
+    emi_dstack_free(s);
+}
+static void bench_stack_pushArray(Bench *b) {
+    Dstack *s = emi_dstack_create(b->data_size, b->data_type);
+    start();
+    emi_dstack_pushArray(s, b->array, b->size);
+    stop(1);
+    emi_dstack_free(s);
+}
+
+/* these go through the whole stack once, one call per element */
+#define BENCH_STACK(name, call)                     \
+static void bench_stack_##name(Bench *b) {          \
+    Dstack *s = stackCopy(b);                       \
+    char output[b->data_size];                      \
+    start();                                        \
+    for(long i=0; i<b->size; i++) { call; }         \
+    stop(b->size);                                  \
+    sink += output[0];                              \
+    emi_dstack_free(s);                             \
+}
+BENCH_STACK(peek,       free(emi_dstack_peek(s)); emi_dstack_popSilent(s); output[0] = 0)
+BENCH_STACK(peekInto,   emi_dstack_peekInto(s, output); emi_dstack_popSilent(s))
+BENCH_STACK(top,        sink += *(char*) emi_dstack_top(s); emi_dstack_popSilent(s); output[0] = 0)
+BENCH_STACK(pop,        free(emi_dstack_pop(s)); output[0] = 0)
+BENCH_STACK(popInto,    emi_dstack_popInto(s, output))
+BENCH_STACK(popRaw,     sink += *(char*) emi_dstack_popRaw(s); output[0] = 0)
+BENCH_STACK(popSilent,  emi_dstack_popSilent(s); output[0] = 0)
+BENCH_STACK(size,       sink += emi_dstack_size(s); output[0] = 0)
+BENCH_STACK(dataSize,   sink += emi_dstack_dataSize(s); output[0] = 0)
+BENCH_STACK(isEmpty,    sink += emi_dstack_isEmpty(s); output[0] = 0)
+
+static void bench_stack_clear(Bench *b) {
+    Dstack *s = stackCopy(b);
+    start();
+    emi_dstack_clear(s);
+    stop(1);
+    emi_dstack_free(s);
+}
+static void bench_stack_reserve(Bench *b) {
+    Dstack *s = stackCopy(b);
+    start();
+    emi_dstack_reserve(s, 2 * emi_dstack_size(s) + 1);
+    stop(1);
+    emi_dstack_free(s);
+}
+static void bench_stack_shrinkToFit(Bench *b) {
+    Dstack *s = stackCopy(b);
+    start();
+    emi_dstack_shrinkToFit(s);
+    stop(1);
+    emi_dstack_free(s);
+}
+static void bench_stack_free(Bench *b) {
+    Dstack *s = stackCopy(b);
+    start();
+    emi_dstack_free(s);
+    stop(1);
+}
+static void bench_stack_save(Bench *b) {
+    Dstack *s = stackCopy(b);
+    FILE *file = tmpfile();
+    start();
+    emi_dstack_save(s, file);
+    fflush(file);
+    stop(1);
+    fclose(file);
+    emi_dstack_free(s);
+}
+static void bench_stack_load(Bench *b) {
+    FILE *file = fopen(b->path, "rb");
+    start();
+    Dstack *s = emi_dstack_load(file);
+    stop(1);
+    fclose(file);
+    emi_dstack_free(s);
+}
+
+
+
+
+/*--------------- ALL OF THEM ---------------*/
+typedef struct {
+    char *function;
+    char *workload;
+    void (*run)(Bench*);
+    bool  strings_only; /* the string functions only make sense for chars */
+} BenchCase;
+
+#define DLIST(name, workload)  {"emi_dlist_"  #name, workload, bench_##name,       false}
+#define DSTACK(name, workload) {"emi_dstack_" #name, workload, bench_stack_##name, false}
+
+static BenchCase cases[] = {
+    DLIST(create,              "create"),
+    DLIST(createWithParas,     "create"),
+    DLIST(createWithAllocator, "create"),
+    DLIST(createFromArray,     "create"),
+    DLIST(createCopy,          "create"),
+    DLIST(createSublist,       "create"),
+    DLIST(createSplit,         "create"),
+    DLIST(createFromView,      "create"),
+    DLIST(setCopyOnWrite,      "create"),
+    DLIST(openMapped,          "file"),
+    DLIST(sync,                "file"),
+    DLIST(close,               "file"),
+    DLIST(save,                "file"),
+    DLIST(load,                "file"),
+    DLIST(loadChunked,         "file"),
+    DLIST(read,                "random-read"),
+    DLIST(readRaw,             "random-read"),
+    DLIST(readInto,            "random-read"),
+    DLIST(append,              "append"),
+    DLIST(createHuge,          "append"),
+    DLIST(prepend,             "random-insert"),
+    DLIST(insert,              "random-insert"),
+    DLIST(insertRange,         "random-insert"),
+    DLIST(remove,              "random-remove"),
+    DLIST(removeRange,         "random-remove"),
+    DLIST(pop,                 "pop"),
+    DLIST(popInto,             "pop"),
+    DLIST(set,                 "random-write"),
+    DLIST(swap,                "random-write"),
+    DLIST(extendByArray,       "append"),
+    DLIST(extendByDlist,       "append"),
+    DLIST(randomizeOrder,      "sort"),
+    DLIST(betterSort,          "sort"),
+    DLIST(betterSortByOrder,   "sort"),
+    DLIST(stableSort,          "sort"),
+    DLIST(stableSortByOrder,   "sort"),
+    DLIST(radixSort,           "sort"),
+    DLIST(parallelSort,        "sort"),
+    DLIST(bubbleSort,          "sort"),
+    DLIST(bubbleSortByOrder,   "sort"),
+    DLIST(reverse,             "sort"),
+    DLIST(filter,              "whole"),
+    DLIST(filterBlock,         "whole"),
+    DLIST(removeDuplicates,    "whole"),
+    DLIST(find,                "search"),
+    DLIST(count,               "search"),
+    DLIST(findByCondition,     "search"),
+    DLIST(findAll,             "search"),
+    DLIST(findAllByCondition,  "search"),
+    DLIST(viewFind,            "search"),
+    DLIST(lowerBound,          "sorted-search"),
+    DLIST(upperBound,          "sorted-search"),
+    DLIST(binarySearch,        "sorted-search"),
+    DLIST(insertSorted,        "random-insert"),
+    DLIST(mergeSorted,         "whole"),
+    DLIST(createEytzinger,     "whole"),
+    DLIST(eytzingerLowerBound, "sorted-search"),
+    DLIST(eytzingerSearch,     "sorted-search"),
+    DLIST(viewLowerBound,      "sorted-search"),
+    DLIST(uniqueElements,      "whole"),
+    DLIST(intersection,        "whole"),
+    DLIST(union,               "whole"),
+    DLIST(viewIntersection,    "whole"),
+    DLIST(map,                 "whole"),
+    DLIST(mapBlock,            "whole"),
+    DLIST(reduce,              "whole"),
+    DLIST(reduceBlock,         "whole"),
+    DLIST(parallelMap,         "whole"),
+    DLIST(parallelReduce,      "whole"),
+    DLIST(size,                "metadata"),
+    DLIST(dataSize,            "metadata"),
+    DLIST(isEmpty,             "metadata"),
+    DLIST(print,               "print"),
+    {"emi_dlist_printString",  "print", bench_printString,  true},
+    {"emi_dlist_sprintString", "print", bench_sprintString, true},
+    DLIST(clear,               "whole"),
+    DLIST(reserve,             "whole"),
+    DLIST(shrinkToFit,         "whole"),
+    DLIST(free,                "whole"),
+
+    DSTACK(create,             "create"),
+    DSTACK(createWithParas,    "create"),
+    DSTACK(createWithAllocator, "create"),
+    DSTACK(createFromArray,    "create"),
+    DSTACK(createCopy,         "create"),
+    DSTACK(push,               "push"),
+    DSTACK(pushArray,          "push"),
+    DSTACK(peek,               "pop"),
+    DSTACK(peekInto,           "pop"),
+    DSTACK(top,                "pop"),
+    DSTACK(pop,                "pop"),
+    DSTACK(popInto,            "pop"),
+    DSTACK(popRaw,             "pop"),
+    DSTACK(popSilent,          "pop"),
+    DSTACK(size,               "metadata"),
+    DSTACK(dataSize,           "metadata"),
+    DSTACK(isEmpty,            "metadata"),
+    DSTACK(clear,              "whole"),
+    DSTACK(reserve,            "whole"),
+    DSTACK(shrinkToFit,        "whole"),
+    DSTACK(free,               "whole"),
+    DSTACK(save,               "file"),
+    DSTACK(load,               "file"),
+};
+
+
+static void runCase(BenchCase *bench_case, Bench *b) {
+    total_ns = total_ops = total_allocations = 0;
+    int runs = 0;
+    do {
+        bench_case->run(b);
+        runs++;
+    } while(total_ns < BENCH_MIN_NS && runs < BENCH_MAX_RUNS);
+
+#ifdef BENCH_COUNT_ALLOCATIONS
+    double allocations_per_op = (double) total_allocations / total_ops;
+#else
+    double allocations_per_op = -1;
+#endif
+    printf("%s,%s,%s,%d,%ld,%lld,%.3f,%.4f\n", BENCH_VERSION, bench_case->function, bench_case->workload,
+           b->data_size, b->size, total_ops / runs, (double) total_ns / total_ops, allocations_per_op);
+    fflush(stdout);
+}
+
+
+int main(int argc, char **argv) {
+    long max_size  = argc > 1 ? atol(argv[1]) : 10000000;
+    long max_bytes = argc > 2 ? atol(argv[2]) : 256L << 20;
+    char *only     = argc > 3 ? argv[3] : NULL;
+    int element_sizes[] = {1, 4, 16, 64};
+
+    srand(1);
+    Pool *pool = emi_pool_create(sysconf(_SC_NPROCESSORS_ONLN));
+    printf("version,function,workload,data_size,size,ops,ns_per_op,allocs_per_op\n");
+
+    for(int e=0; e<4; e++) {
+        for(long size=10; size<=max_size; size*=10) {
+            if(size * element_sizes[e] > max_bytes) {
+                fprintf(stderr, "skipping %ld elements of %d bytes, that's more than %ld bytes\n", size, element_sizes[e], max_bytes);
+                continue;
+            }
+            fprintf(stderr, "%ld elements of %d bytes\n", size, element_sizes[e]);
+            Bench *b = benchCreate(element_sizes[e], size, pool);
+            for(size_t i=0; i<sizeof(cases)/sizeof(cases[0]); i++) {
+                if(only != NULL && strstr(cases[i].function, only) == NULL) continue;
+                if(cases[i].strings_only && element_sizes[e] != 1) continue;
+                runCase(&cases[i], b);
+            }
+            benchFree(b);
+        }
+    }
+
+    emi_pool_free(pool);
+    return 0;
+}
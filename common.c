@@ -1,10 +1,18 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <limits.h>
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__)
+#define COMMON_X86_SIMD
+#include <immintrin.h>
+#endif
 
 #include "common.h"
 
 
-void _common_fixIndex(int size, int *index) {
+void _common_fixIndex(ptrdiff_t size, ptrdiff_t *index) {
     /* we check the following case seperately because a lot of times,
     this function will be run on an index which has already been fixes,
     so this saves time since it prevents us from doing
@@ -22,7 +30,7 @@ void _common_fixIndex(int size, int *index) {
 }
 
 
-void _common_fixIndexInclusive(int size, int *index) {
+void _common_fixIndexInclusive(ptrdiff_t size, ptrdiff_t *index) {
     /* this function is for when you are in a situation
     where, if a list has length a, _common_fixIndex(a, &a)
     should keep the index as a, rather than bringing it 
@@ -32,6 +40,29 @@ void _common_fixIndexInclusive(int size, int *index) {
 }
 
 
+int _common_checkedBytes(ptrdiff_t count, int data_size, size_t *bytes) {
+    /* count * data_size, for everything that gets allocated. Anything
+    negative or too big to be indexed with a ptrdiff_t is refused.
+    0 is returned in case of success, 1 in case of failure */
+    if(count < 0 || data_size <= 0 || count > PTRDIFF_MAX / data_size) return 1;
+    *bytes = (size_t) count * data_size;
+    return 0;
+}
+
+ptrdiff_t _common_grownSize(ptrdiff_t max_size, float growth_exponential, ptrdiff_t goal_size, int data_size) {
+    /* the size to grow to, max_size times the growth exponential, but at
+    least goal_size and at most what still fits in a ptrdiff_t of bytes.
+    Done in doubles, so it can't overflow along the way */
+    double grown = (double) max_size * growth_exponential;
+    double limit = (double) (PTRDIFF_MAX / data_size);
+    if(grown > limit) grown = limit;
+    ptrdiff_t new_max_size = (ptrdiff_t) grown;
+    if(new_max_size <= max_size) new_max_size = max_size + 1;
+    if(new_max_size < goal_size) new_max_size = goal_size;
+    return new_max_size;
+}
+
+
 
 
 
@@ -49,8 +80,7 @@ int _common_defaultOrder(int data_type, void *a, void *b) {
     //     return 0;
     //     break;
     case DATA_TYPE_INT:
-        if(*(int*)a == *(int*)b) return 0;
-        return (*(int*)a < *(int*)b)*2-1;
+        return _common_intOrder(a, b);
         break;
     // case DATA_TYPE_FLOAT:
     //     if(*(float*)a == *(float*)b) return 0;
@@ -64,6 +94,30 @@ int _common_defaultOrder(int data_type, void *a, void *b) {
 }
 
 
+int _common_intOrder(void *a, void *b) {
+    if(*(int*)a == *(int*)b) return 0;
+    return (*(int*)a < *(int*)b)*2-1;
+}
+
+int _common_noOrder(void *a, void *b) {
+    (void) a;
+    (void) b;
+    return 0;
+}
+
+int (*_common_orderFunction(int data_type))(void*, void*) {
+    /* the same order as _common_defaultOrder, but as a function
+    pointer, so the sorting functions don't have to go through
+    the switch on every single comparison */
+    switch(data_type) {
+    case DATA_TYPE_INT:
+        return _common_intOrder;
+    default:
+        return _common_noOrder;
+    }
+}
+
+
 int _common_charOrderBlock(char c) {
     if('a' < c && c < 'z') return 4; /* small letters */
     if('A' < c && c < 'Z') return 3; /* uppercase letters */
@@ -170,4 +224,974 @@ void _common_printData(void* data, int datasize, int datatype) {
 
 
     }
-}
\ No newline at end of file
+}
+
+
+
+
+
+
+
+
+
+/*--------------- HASHING FUNCTIONS ---------------*/
+uint64_t _common_mix64(uint64_t x) {
+    /* the finalizer of murmurhash3, every input bit affects every output bit */
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+uint64_t _common_hashBytes(void *data, int data_size) {
+    /* hashes the raw bytes, so two elements which are the same
+    according to memcmp always get the same hash */
+    unsigned char *bytes = (unsigned char*) data;
+    uint64_t hash = 0x9e3779b97f4a7c15ULL ^ (uint64_t) data_size;
+    uint64_t chunk;
+
+    switch(data_size) { /* the common small sizes in one go */
+    case 1: return _common_mix64(hash ^ bytes[0]);
+    case 2: { uint16_t x; memcpy(&x, bytes, 2); return _common_mix64(hash ^ x); }
+    case 4: { uint32_t x; memcpy(&x, bytes, 4); return _common_mix64(hash ^ x); }
+    case 8: memcpy(&chunk, bytes, 8); return _common_mix64(hash ^ chunk);
+    }
+
+    while(data_size >= 8) {
+        memcpy(&chunk, bytes, 8);
+        hash = _common_mix64(hash ^ chunk) + 0x9e3779b97f4a7c15ULL;
+        bytes += 8;
+        data_size -= 8;
+    }
+    chunk = 0;
+    memcpy(&chunk, bytes, data_size);
+    return _common_mix64(hash ^ chunk);
+}
+uint64_t _common_hash(void *data, int data_size, int data_type) {
+    /* hashes a single value of the datatype directly, and anything
+    else (strings, arrays of values, default data) by its bytes.
+    It only ever looks at the bytes, so it agrees with memcmp */
+    if(data_size != _common_sizeof(data_type))
+        return _common_hashBytes(data, data_size);
+
+    switch(data_type) {
+    case DATA_TYPE_CHAR:
+        return _common_mix64(*(unsigned char*) data);
+    case DATA_TYPE_INT: {
+        unsigned int value;
+        memcpy(&value, data, sizeof(int));
+        return _common_mix64(value);
+    }
+    case DATA_TYPE_FLOAT: {
+        uint32_t bits;
+        memcpy(&bits, data, sizeof(float));
+        return _common_mix64(bits);
+    }
+    case DATA_TYPE_PTR: {
+        uintptr_t address;
+        memcpy(&address, data, sizeof(void*));
+        return _common_mix64(address);
+    }
+    default:
+        return _common_hashBytes(data, data_size);
+    }
+}
+
+
+
+
+
+
+
+
+
+/*--------------- SORTING FUNCTIONS ---------------*/
+/* the order functions return 1 if a should come before b, -1 if b
+should come before a, and 0 if it doesn't matter. So 'a < b' in the
+sorting sense is order(a, b) > 0 */
+#define SORT_LESS(sorter, a, b) ((sorter)->order((a), (b)) > 0)
+
+#define SORT_INSERTION_THRESHOLD     24
+#define SORT_NINTHER_THRESHOLD       128
+#define SORT_PARTIAL_INSERTION_LIMIT 8
+#define SORT_MERGE_RUN               16
+#define SORT_STACK_ELEMENT           64 /* elements up to this size don't need a malloc for the scratch space */
+
+typedef struct {
+    int data_size;
+    int (*order)(void*, void*);
+    char *pivot; /* scratch space for one element */
+    char *temp;  /* and another one */
+} _CommonSorter;
+
+
+static inline void _common_copyElement(char *destination, char *source, int data_size) {
+    /* the fixed size memcpys get turned into single moves by the compiler,
+    the generic one is an actual call to memcpy */
+    switch(data_size) {
+    case 1: *destination = *source;          return;
+    case 2: memcpy(destination, source, 2); return;
+    case 4: memcpy(destination, source, 4); return;
+    case 8: memcpy(destination, source, 8); return;
+    default: memcpy(destination, source, data_size);
+    }
+}
+
+static inline void _common_swapElements(char *a, char *b, int data_size) {
+    switch(data_size) {
+    case 1: { char     x = *a;              *a = *b;              *b = x;              return; }
+    case 2: { uint16_t x, y; memcpy(&x, a, 2); memcpy(&y, b, 2); memcpy(a, &y, 2); memcpy(b, &x, 2); return; }
+    case 4: { uint32_t x, y; memcpy(&x, a, 4); memcpy(&y, b, 4); memcpy(a, &y, 4); memcpy(b, &x, 4); return; }
+    case 8: { uint64_t x, y; memcpy(&x, a, 8); memcpy(&y, b, 8); memcpy(a, &y, 8); memcpy(b, &x, 8); return; }
+    default: {
+        /* swap in chunks, so we don't need a buffer as large as the element */
+        char buffer[SORT_STACK_ELEMENT];
+        while(data_size > 0) {
+            int chunk = data_size < SORT_STACK_ELEMENT ? data_size : SORT_STACK_ELEMENT;
+            memcpy(buffer, a, chunk);
+            memcpy(a, b, chunk);
+            memcpy(b, buffer, chunk);
+            a += chunk;
+            b += chunk;
+            data_size -= chunk;
+        }
+    }
+    }
+}
+
+
+static void _common_insertionSort(_CommonSorter *sorter, char *begin, char *end, bool guarded) {
+    /* stable. If it is not guarded, the element before begin
+    has to be smaller than or equal to everything in the range */
+    int data_size = sorter->data_size;
+    if(begin == end) return;
+
+    for(char *current = begin + data_size; current < end; current += data_size) {
+        char *sift   = current;
+        char *sift_1 = current - data_size;
+        if(!SORT_LESS(sorter, sift, sift_1)) continue;
+
+        _common_copyElement(sorter->temp, sift, data_size);
+        do {
+            _common_copyElement(sift, sift_1, data_size);
+            sift   -= data_size;
+            sift_1 -= data_size;
+        } while((!guarded || sift != begin) && SORT_LESS(sorter, sorter->temp, sift_1));
+        _common_copyElement(sift, sorter->temp, data_size);
+    }
+}
+
+static bool _common_partialInsertionSort(_CommonSorter *sorter, char *begin, char *end) {
+    /* insertion sort which gives up after moving too many elements,
+    returns whether it managed to sort the range */
+    int data_size = sorter->data_size;
+    if(begin == end) return true;
+
+    ptrdiff_t moves = 0;
+    for(char *current = begin + data_size; current < end; current += data_size) {
+        char *sift   = current;
+        char *sift_1 = current - data_size;
+        if(!SORT_LESS(sorter, sift, sift_1)) continue;
+
+        _common_copyElement(sorter->temp, sift, data_size);
+        do {
+            _common_copyElement(sift, sift_1, data_size);
+            sift   -= data_size;
+            sift_1 -= data_size;
+        } while(sift != begin && SORT_LESS(sorter, sorter->temp, sift_1));
+        _common_copyElement(sift, sorter->temp, data_size);
+
+        moves += (current - sift) / data_size;
+        if(moves > SORT_PARTIAL_INSERTION_LIMIT) return false;
+    }
+    return true;
+}
+
+
+static void _common_sort2(_CommonSorter *sorter, char *a, char *b) {
+    if(SORT_LESS(sorter, b, a)) _common_swapElements(a, b, sorter->data_size);
+}
+
+static void _common_sort3(_CommonSorter *sorter, char *a, char *b, char *c) {
+    _common_sort2(sorter, a, b);
+    _common_sort2(sorter, b, c);
+    _common_sort2(sorter, a, b);
+}
+
+
+static void _common_siftDown(_CommonSorter *sorter, char *begin, ptrdiff_t root, ptrdiff_t length) {
+    int data_size = sorter->data_size;
+    ptrdiff_t child;
+    while((child = 2*root + 1) < length) {
+        if(child + 1 < length && SORT_LESS(sorter, begin + child*data_size, begin + (child+1)*data_size))
+            child++;
+        if(!SORT_LESS(sorter, begin + root*data_size, begin + child*data_size))
+            return;
+        _common_swapElements(begin + root*data_size, begin + child*data_size, data_size);
+        root = child;
+    }
+}
+
+static void _common_heapSort(_CommonSorter *sorter, char *begin, char *end) {
+    /* the fallback for when the quicksort keeps picking bad pivots */
+    int data_size = sorter->data_size;
+    ptrdiff_t length = (end - begin) / data_size;
+    for(ptrdiff_t i=length/2 - 1; i>=0; i--)
+        _common_siftDown(sorter, begin, i, length);
+    for(ptrdiff_t i=length - 1; i>0; i--) {
+        _common_swapElements(begin, begin + i*data_size, data_size);
+        _common_siftDown(sorter, begin, 0, i);
+    }
+}
+
+
+static char *_common_partitionRight(_CommonSorter *sorter, char *begin, char *end, bool *already_partitioned) {
+    /* partitions around the element at begin, elements equal to the
+    pivot go to the right. Returns where the pivot ended up */
+    int data_size = sorter->data_size;
+    char *pivot = sorter->pivot;
+    _common_copyElement(pivot, begin, data_size);
+
+    char *first = begin;
+    char *last  = end;
+
+    /* the median of three guarantees there is an element >= the pivot,
+    so this can't run off the end */
+    do first += data_size; while(SORT_LESS(sorter, first, pivot));
+
+    if(first - data_size == begin) {
+        do last -= data_size; while(first < last && !SORT_LESS(sorter, last, pivot));
+    } else {
+        do last -= data_size; while(!SORT_LESS(sorter, last, pivot));
+    }
+
+    *already_partitioned = first >= last;
+
+    while(first < last) {
+        _common_swapElements(first, last, data_size);
+        do first += data_size; while(SORT_LESS(sorter, first, pivot));
+        do last  -= data_size; while(!SORT_LESS(sorter, last, pivot));
+    }
+
+    char *pivot_position = first - data_size;
+    _common_copyElement(begin, pivot_position, data_size);
+    _common_copyElement(pivot_position, pivot, data_size);
+    return pivot_position;
+}
+
+static char *_common_partitionLeft(_CommonSorter *sorter, char *begin, char *end) {
+    /* same thing, but elements equal to the pivot go to the left. This is
+    used when the pivot is equal to the element before the range, so
+    everything equal to it is already in its final place afterwards */
+    int data_size = sorter->data_size;
+    char *pivot = sorter->pivot;
+    _common_copyElement(pivot, begin, data_size);
+
+    char *first = begin;
+    char *last  = end;
+
+    do last -= data_size; while(SORT_LESS(sorter, pivot, last));
+
+    if(last + data_size == end) {
+        do first += data_size; while(first < last && !SORT_LESS(sorter, pivot, first));
+    } else {
+        do first += data_size; while(!SORT_LESS(sorter, pivot, first));
+    }
+
+    while(first < last) {
+        _common_swapElements(first, last, data_size);
+        do last  -= data_size; while(SORT_LESS(sorter, pivot, last));
+        do first += data_size; while(!SORT_LESS(sorter, pivot, first));
+    }
+
+    _common_copyElement(begin, last, data_size);
+    _common_copyElement(last, pivot, data_size);
+    return last;
+}
+
+
+static void _common_breakPatterns(_CommonSorter *sorter, char *begin, char *end) {
+    /* swaps some elements around after a bad partition, so
+    whatever pattern made the pivot bad is (probably) gone */
+    int data_size = sorter->data_size;
+    ptrdiff_t length  = (end - begin) / data_size;
+    ptrdiff_t quarter = length / 4;
+
+    if(length < SORT_INSERTION_THRESHOLD) return;
+
+    _common_swapElements(begin,                 begin + quarter*data_size,     data_size);
+    _common_swapElements(end - data_size,       end - quarter*data_size,       data_size);
+    if(length > SORT_NINTHER_THRESHOLD) {
+        _common_swapElements(begin + data_size,   begin + (quarter+1)*data_size, data_size);
+        _common_swapElements(begin + 2*data_size, begin + (quarter+2)*data_size, data_size);
+        _common_swapElements(end - 2*data_size,   end - (quarter+1)*data_size,   data_size);
+        _common_swapElements(end - 3*data_size,   end - (quarter+2)*data_size,   data_size);
+    }
+}
+
+
+static void _common_pdqSort(_CommonSorter *sorter, char *begin, char *end, int bad_allowed, bool leftmost) {
+    /* pattern-defeating quicksort (Orson Peters). Small ranges get an
+    insertion sort, ranges that are already partitioned get a partial
+    insertion sort, and if the pivots keep being bad we give up and
+    heapsort, so it stays O(n log n) */
+    int data_size = sorter->data_size;
+
+    while(true) {
+        ptrdiff_t length = (end - begin) / data_size;
+
+        if(length < SORT_INSERTION_THRESHOLD) {
+            _common_insertionSort(sorter, begin, end, leftmost);
+            return;
+        }
+
+        ptrdiff_t half = length / 2;
+        if(length > SORT_NINTHER_THRESHOLD) {
+            _common_sort3(sorter, begin,                 begin + half*data_size,     end - data_size);
+            _common_sort3(sorter, begin + data_size,     begin + (half-1)*data_size, end - 2*data_size);
+            _common_sort3(sorter, begin + 2*data_size,   begin + (half+1)*data_size, end - 3*data_size);
+            _common_sort3(sorter, begin + (half-1)*data_size, begin + half*data_size, begin + (half+1)*data_size);
+            _common_swapElements(begin, begin + half*data_size, data_size);
+        } else {
+            _common_sort3(sorter, begin + half*data_size, begin, end - data_size);
+        }
+
+        /* if the pivot is equal to the element before this range, there's
+        nothing smaller than the pivot in here, so we only need to split off
+        the elements equal to it */
+        if(!leftmost && !SORT_LESS(sorter, begin - data_size, begin)) {
+            begin = _common_partitionLeft(sorter, begin, end) + data_size;
+            continue;
+        }
+
+        bool already_partitioned;
+        char *pivot_position = _common_partitionRight(sorter, begin, end, &already_partitioned);
+
+        ptrdiff_t left_length  = (pivot_position - begin) / data_size;
+        ptrdiff_t right_length = (end - (pivot_position + data_size)) / data_size;
+
+        if(left_length < length / 8 || right_length < length / 8) {
+            if(--bad_allowed == 0) {
+                _common_heapSort(sorter, begin, end);
+                return;
+            }
+            _common_breakPatterns(sorter, begin, pivot_position);
+            _common_breakPatterns(sorter, pivot_position + data_size, end);
+        } else if(already_partitioned
+                  && _common_partialInsertionSort(sorter, begin, pivot_position)
+                  && _common_partialInsertionSort(sorter, pivot_position + data_size, end)) {
+            return;
+        }
+
+        _common_pdqSort(sorter, begin, pivot_position, bad_allowed, leftmost);
+        begin = pivot_position + data_size;
+        leftmost = false;
+    }
+}
+
+
+int _common_sort(char *data, ptrdiff_t length, int data_size, int(*order)(void*, void*)) {
+    /* unstable in-place sort, O(n log n) worst case.
+    0 is returned in case of success, 1 in case of failure */
+    if(length < 2) return 0;
+
+    char stack_scratch[2 * SORT_STACK_ELEMENT];
+    char *scratch = stack_scratch;
+    if(data_size > SORT_STACK_ELEMENT) {
+        scratch = (char*) malloc (2 * data_size);
+        if(scratch == NULL) {
+            printf("malloc failed in _common_sort :(\n");
+            return 1;
+        }
+    }
+
+    _CommonSorter sorter = { data_size, order, scratch, scratch + data_size };
+
+    int bad_allowed = 0;
+    for(ptrdiff_t i=length; i>0; i >>= 1) bad_allowed++;
+
+    _common_pdqSort(&sorter, data, data + length * data_size, bad_allowed, true);
+
+    if(scratch != stack_scratch) free(scratch);
+    return 0;
+}
+
+
+static void _common_mergeRuns(_CommonSorter *sorter, char *begin, char *middle, char *end, char *buffer) {
+    /* merges [begin, middle) and [middle, end) in place, using buffer
+    to hold the left run. Equal elements are taken from the left first */
+    int data_size = sorter->data_size;
+
+    /* the runs are already in order */
+    if(!SORT_LESS(sorter, middle, middle - data_size)) return;
+
+    memcpy(buffer, begin, middle - begin);
+    char *left      = buffer;
+    char *left_end  = buffer + (middle - begin);
+    char *right     = middle;
+    char *output    = begin;
+
+    while(left < left_end && right < end) {
+        if(SORT_LESS(sorter, right, left)) {
+            _common_copyElement(output, right, data_size);
+            right += data_size;
+        } else {
+            _common_copyElement(output, left, data_size);
+            left += data_size;
+        }
+        output += data_size;
+    }
+    /* whatever is left of the right run is already in place */
+    memcpy(output, left, left_end - left);
+}
+
+int _common_stableSort(char *data, ptrdiff_t length, int data_size, int(*order)(void*, void*)) {
+    /* bottom up merge sort, needs a buffer as large as the data (the left
+    run of the last merge can be almost all of it).
+    0 is returned in case of success, 1 in case of failure */
+    if(length < 2) return 0;
+
+    char *buffer = (char*) malloc (((size_t) length + 1) * data_size);
+    if(buffer == NULL) {
+        printf("malloc failed in _common_stableSort :(\n");
+        return 1;
+    }
+
+    /* the last element of the buffer is the scratch space for the insertion sort */
+    _CommonSorter sorter = { data_size, order, NULL, buffer + length * data_size };
+    char *end = data + length * data_size;
+
+    for(char *run = data; run < end; run += SORT_MERGE_RUN * data_size) {
+        char *run_end = run + SORT_MERGE_RUN * data_size;
+        if(run_end > end) run_end = end;
+        _common_insertionSort(&sorter, run, run_end, true);
+    }
+
+    for(ptrdiff_t width = SORT_MERGE_RUN; width < length; width *= 2) {
+        for(ptrdiff_t start = 0; start + width < length; start += 2*width) {
+            ptrdiff_t stop = start + 2*width;
+            if(stop > length) stop = length;
+            _common_mergeRuns(&sorter, data + start*data_size, data + (start + width)*data_size, data + stop*data_size, buffer);
+        }
+    }
+
+    free(buffer);
+    return 0;
+}
+
+
+
+static inline unsigned int _common_radixKey(char *element, int data_type) {
+    /* turns the first value of the element into an unsigned key
+    which sorts the same way as the value itself */
+    switch(data_type) {
+    case DATA_TYPE_INT: {
+        unsigned int key;
+        memcpy(&key, element, sizeof(int));
+        return key ^ (UINT_MAX/2 + 1); /* flip the sign bit, so negatives come first */
+    }
+    case DATA_TYPE_FLOAT: {
+        uint32_t key;
+        memcpy(&key, element, sizeof(float));
+        /* negative floats are stored as sign + magnitude, so all
+        their bits get flipped, positive ones only the sign bit */
+        return (key & 0x80000000u) ? ~key : key ^ 0x80000000u;
+    }
+    default: /* DATA_TYPE_CHAR */
+        return (unsigned char) (*element ^ (CHAR_MIN < 0 ? 0x80 : 0));
+    }
+}
+
+int _common_radixSort(char *data, ptrdiff_t length, int data_size, int data_type) {
+    /* LSD radix sort on the first value of every element, one byte per pass.
+    Only works for chars, ints and floats, and it is stable.
+    0 is returned in case of success, 1 in case of failure */
+    int key_size;
+    switch(data_type) {
+    case DATA_TYPE_CHAR:  key_size = sizeof(char);  break;
+    case DATA_TYPE_INT:   key_size = sizeof(int);   break;
+    case DATA_TYPE_FLOAT: key_size = sizeof(float); break;
+    default:
+        printf("can't radix sort this datatype\n");
+        return 1;
+    }
+    if(data_size < key_size || data_size % key_size != 0) {
+        printf("can't radix sort, the data size isn't a multiple of the size of the datatype\n");
+        return 1;
+    }
+    if(length < 2) return 0;
+
+    /* counting all the digits at once saves a pass over the data per digit */
+    size_t counts[sizeof(unsigned int)][256];
+    memset(counts, 0, sizeof(counts));
+
+    char *current_item = data;
+    for(ptrdiff_t i=0; i<length; i++) {
+        unsigned int key = _common_radixKey(current_item, data_type);
+        for(int digit=0; digit<key_size; digit++)
+            counts[digit][(key >> (8*digit)) & 0xff]++;
+        current_item += data_size;
+    }
+
+    char *buffer = (char*) malloc ((size_t) length * data_size);
+    if(buffer == NULL) {
+        printf("malloc failed in _common_radixSort :(\n");
+        return 1;
+    }
+
+    char *source      = data;
+    char *destination = buffer;
+    for(int digit=0; digit<key_size; digit++) {
+        int shift = 8*digit;
+
+        /* if every element has the same digit here, this pass wouldn't change anything */
+        if(counts[digit][(_common_radixKey(source, data_type) >> shift) & 0xff] == (size_t) length)
+            continue;
+
+        size_t offsets[256];
+        size_t total = 0;
+        for(int bucket=0; bucket<256; bucket++) {
+            offsets[bucket] = total;
+            total += counts[digit][bucket];
+        }
+
+        current_item = source;
+        for(ptrdiff_t i=0; i<length; i++) {
+            unsigned int bucket = (_common_radixKey(current_item, data_type) >> shift) & 0xff;
+            _common_copyElement(destination + offsets[bucket] * data_size, current_item, data_size);
+            offsets[bucket]++;
+            current_item += data_size;
+        }
+
+        char *swap  = source;
+        source      = destination;
+        destination = swap;
+    }
+
+    if(source != data)
+        memcpy(data, source, (size_t) length * data_size);
+
+    free(buffer);
+    return 0;
+}
+
+
+
+ptrdiff_t _common_mergeSplit(char *left, ptrdiff_t left_length, char *right, ptrdiff_t right_length, ptrdiff_t output_index, int data_size, int(*order)(void*, void*)) {
+    /* when merging left and right (stably, equal elements from left first),
+    returns how many of the first output_index merged elements come from left.
+    This lets multiple threads each merge their own part of the output */
+    ptrdiff_t low  = output_index - right_length > 0 ? output_index - right_length : 0;
+    ptrdiff_t high = output_index < left_length ? output_index : left_length;
+
+    while(low < high) {
+        ptrdiff_t taken_left  = low + (high - low) / 2;
+        ptrdiff_t taken_right = output_index - taken_left;
+        /* if the next left element isn't after the last right element we
+        took, it should have been taken before it, so take more from left */
+        if(order(right + (taken_right - 1) * data_size, left + taken_left * data_size) <= 0)
+            low = taken_left + 1;
+        else
+            high = taken_left;
+    }
+    return low;
+}
+
+void _common_merge(char *left, ptrdiff_t left_length, char *right, ptrdiff_t right_length, char *output, int data_size, int(*order)(void*, void*)) {
+    /* merges two sorted ranges into output, which can't overlap with either.
+    Equal elements are taken from left first, so this is stable */
+    char *left_end  = left  + left_length  * data_size;
+    char *right_end = right + right_length * data_size;
+
+    while(left < left_end && right < right_end) {
+        if(order(right, left) > 0) {
+            _common_copyElement(output, right, data_size);
+            right += data_size;
+        } else {
+            _common_copyElement(output, left, data_size);
+            left += data_size;
+        }
+        output += data_size;
+    }
+    memcpy(output, left, left_end - left);
+    output += left_end - left;
+    memcpy(output, right, right_end - right);
+}
+
+
+
+
+
+
+
+
+
+
+/*--------------- SEARCHING FUNCTIONS ---------------*/
+/* find, count and findMany all go through one scanning function, which
+exists three times: plain C, SSE2 (16 bytes at a time) and AVX2 (32 bytes
+at a time). The vector ones only work for elements of 1, 2, 4 or 8 bytes,
+and AVX2 is only used if the cpu says it has it */
+#define SCAN_FIND    0 /* returns the first index, or -1 */
+#define SCAN_COUNT   1 /* returns the amount of matches */
+#define SCAN_COLLECT 2 /* writes indices until capacity is full, returns how many */
+
+static inline bool _common_equalElements(char *a, char *b, int data_size) {
+    switch(data_size) {
+    case 1: return *a == *b;
+    case 2: return memcmp(a, b, 2) == 0;
+    case 4: return memcmp(a, b, 4) == 0;
+    case 8: return memcmp(a, b, 8) == 0;
+    default: return memcmp(a, b, data_size) == 0;
+    }
+}
+
+static ptrdiff_t _common_scanScalar(char *data, ptrdiff_t start, ptrdiff_t length, int data_size, char *needle, int mode, ptrdiff_t *indices, ptrdiff_t capacity) {
+    ptrdiff_t found = 0;
+    char *current_item = data + start * data_size;
+    for(ptrdiff_t i=start; i<length; i++) {
+        if(_common_equalElements(current_item, needle, data_size)) {
+            if(mode == SCAN_FIND) return i;
+            if(mode == SCAN_COLLECT) {
+                if(found == capacity) return found;
+                indices[found] = i;
+            }
+            found++;
+        }
+        current_item += data_size;
+    }
+    return mode == SCAN_FIND ? -1 : found;
+}
+
+
+#ifdef COMMON_X86_SIMD
+static inline ptrdiff_t _common_scanMask(uint32_t mask, ptrdiff_t base, int data_size, int mode, ptrdiff_t *indices, ptrdiff_t capacity, ptrdiff_t *found) {
+    /* handles the comparison mask of one block. Every matching element has
+    data_size bits set in the mask. Returns an index if scanning is done */
+    if(mode == SCAN_COUNT) {
+        *found += __builtin_popcount(mask) / data_size;
+        return -1;
+    }
+    if(mode == SCAN_FIND)
+        return base + __builtin_ctz(mask) / data_size;
+
+    uint32_t element_bits = (1u << data_size) - 1;
+    while(mask != 0) {
+        int bit = __builtin_ctz(mask);
+        if(*found == capacity) return *found;
+        indices[(*found)++] = base + bit / data_size;
+        mask &= ~(element_bits << bit);
+    }
+    return -1;
+}
+
+static ptrdiff_t _common_scanSse2(char *data, ptrdiff_t start, ptrdiff_t length, int data_size, char *needle, int mode, ptrdiff_t *indices, ptrdiff_t capacity) {
+    __m128i needles;
+    switch(data_size) {
+    case 1:  needles = _mm_set1_epi8(*needle); break;
+    case 2:  { int16_t x; memcpy(&x, needle, 2); needles = _mm_set1_epi16(x); break; }
+    case 4:  { int32_t x; memcpy(&x, needle, 4); needles = _mm_set1_epi32(x); break; }
+    default: { int64_t x; memcpy(&x, needle, 8); needles = _mm_set1_epi64x(x); break; }
+    }
+
+    int per_block = 16 / data_size;
+    ptrdiff_t found = 0;
+    ptrdiff_t i = start;
+    for(; i + per_block <= length; i += per_block) {
+        __m128i values = _mm_loadu_si128((__m128i*) (data + i * data_size));
+        __m128i equal;
+        switch(data_size) {
+        case 1:  equal = _mm_cmpeq_epi8 (values, needles); break;
+        case 2:  equal = _mm_cmpeq_epi16(values, needles); break;
+        case 4:  equal = _mm_cmpeq_epi32(values, needles); break;
+        default: /* SSE2 can't compare 64 bits, so both halves have to be equal */
+            equal = _mm_cmpeq_epi32(values, needles);
+            equal = _mm_and_si128(equal, _mm_shuffle_epi32(equal, _MM_SHUFFLE(2, 3, 0, 1)));
+        }
+        uint32_t mask = _mm_movemask_epi8(equal);
+        if(mask == 0) continue;
+        ptrdiff_t result = _common_scanMask(mask, i, data_size, mode, indices, capacity, &found);
+        if(result != -1) return result;
+    }
+
+    /* the last few elements that don't fill a block. Only collecting has
+    indices, counting and finding pass NULL, which can't be added to */
+    ptrdiff_t rest = _common_scanScalar(data, i, length, data_size, needle, mode, indices == NULL ? NULL : indices + found, capacity - found);
+    if(mode == SCAN_FIND) return rest;
+    return found + rest;
+}
+
+__attribute__((target("avx2")))
+static ptrdiff_t _common_scanAvx2(char *data, ptrdiff_t start, ptrdiff_t length, int data_size, char *needle, int mode, ptrdiff_t *indices, ptrdiff_t capacity) {
+    __m256i needles;
+    switch(data_size) {
+    case 1:  needles = _mm256_set1_epi8(*needle); break;
+    case 2:  { int16_t x; memcpy(&x, needle, 2); needles = _mm256_set1_epi16(x); break; }
+    case 4:  { int32_t x; memcpy(&x, needle, 4); needles = _mm256_set1_epi32(x); break; }
+    default: { int64_t x; memcpy(&x, needle, 8); needles = _mm256_set1_epi64x(x); break; }
+    }
+
+    int per_block = 32 / data_size;
+    ptrdiff_t found = 0;
+    ptrdiff_t i = start;
+    for(; i + per_block <= length; i += per_block) {
+        __m256i values = _mm256_loadu_si256((__m256i*) (data + i * data_size));
+        __m256i equal;
+        switch(data_size) {
+        case 1:  equal = _mm256_cmpeq_epi8 (values, needles); break;
+        case 2:  equal = _mm256_cmpeq_epi16(values, needles); break;
+        case 4:  equal = _mm256_cmpeq_epi32(values, needles); break;
+        default: equal = _mm256_cmpeq_epi64(values, needles);
+        }
+        uint32_t mask = _mm256_movemask_epi8(equal);
+        if(mask == 0) continue;
+        ptrdiff_t result = _common_scanMask(mask, i, data_size, mode, indices, capacity, &found);
+        if(result != -1) return result;
+    }
+
+    ptrdiff_t rest = _common_scanScalar(data, i, length, data_size, needle, mode, indices == NULL ? NULL : indices + found, capacity - found);
+    if(mode == SCAN_FIND) return rest;
+    return found + rest;
+}
+
+static bool _common_hasAvx2(void) {
+    /* asks the cpu (through cpuid) once, and remembers it */
+    static int has_avx2 = -1;
+    if(has_avx2 == -1) {
+        __builtin_cpu_init();
+        has_avx2 = __builtin_cpu_supports("avx2") != 0;
+    }
+    return has_avx2;
+}
+#endif
+
+
+static ptrdiff_t _common_scan(char *data, ptrdiff_t start, ptrdiff_t length, int data_size, char *needle, int mode, ptrdiff_t *indices, ptrdiff_t capacity) {
+#ifdef COMMON_X86_SIMD
+    if(data_size == 1 || data_size == 2 || data_size == 4 || data_size == 8) {
+        if(_common_hasAvx2())
+            return _common_scanAvx2(data, start, length, data_size, needle, mode, indices, capacity);
+        return _common_scanSse2(data, start, length, data_size, needle, mode, indices, capacity);
+    }
+#endif
+    return _common_scanScalar(data, start, length, data_size, needle, mode, indices, capacity);
+}
+
+
+ptrdiff_t _common_find(char *data, ptrdiff_t length, int data_size, void *data_to_find) {
+    return _common_scan(data, 0, length, data_size, (char*) data_to_find, SCAN_FIND, NULL, 0);
+}
+
+ptrdiff_t _common_count(char *data, ptrdiff_t length, int data_size, void *data_to_find) {
+    return _common_scan(data, 0, length, data_size, (char*) data_to_find, SCAN_COUNT, NULL, 0);
+}
+
+ptrdiff_t _common_findMany(char *data, ptrdiff_t start, ptrdiff_t length, int data_size, void *data_to_find, ptrdiff_t *indices, ptrdiff_t capacity) {
+    /* writes the indices of the matches from start onwards into indices.
+    If it returns capacity, there may be more, so continue from the
+    index after the last one written */
+    return _common_scan(data, start, length, data_size, (char*) data_to_find, SCAN_COLLECT, indices, capacity);
+}
+
+
+
+
+
+
+
+/*--------------- FILE FUNCTIONS ---------------*/
+void _common_fileHeaderInit(_CommonFileHeader *header, int data_size, int data_type, int64_t size, float growth_exponential) {
+    memset(header, 0, sizeof(_CommonFileHeader));
+    memcpy(header->magic, FILE_MAGIC, 4);
+    header->version            = FILE_VERSION;
+    header->data_size          = data_size;
+    header->data_type          = data_type;
+    header->size               = size;
+    header->growth_exponential = growth_exponential;
+}
+
+int _common_fileHeaderCheck(_CommonFileHeader *header, int data_size, int data_type) {
+    /* 0 is returned if the file holds what we expect, 1 if it doesn't.
+    A data_size or data_type of -1 means we take whatever is in there */
+    if(memcmp(header->magic, FILE_MAGIC, 4) != 0) {
+        printf("that's not an emidata file\n");
+        return 1;
+    }
+    if(header->version != FILE_VERSION) {
+        printf("can't read version %u files, only version %d\n", header->version, FILE_VERSION);
+        return 1;
+    }
+    if(header->data_size <= 0) {
+        printf("the file says its elements have size %d??\n", header->data_size);
+        return 1;
+    }
+    if((data_size != -1 && header->data_size != data_size) || (data_type != -1 && header->data_type != data_type)) {
+        printf("the file has elements of size %d and type %d, not size %d and type %d\n", header->data_size, header->data_type, data_size, data_type);
+        return 1;
+    }
+    if(header->size < 0) {
+        printf("the file says it has %lld elements??\n", (long long) header->size);
+        return 1;
+    }
+    return 0;
+}
+
+
+int _common_save(FILE *file, char *data, ptrdiff_t size, int data_size, int data_type, float growth_exponential) {
+    /* the header, padded to FILE_HEADER_SIZE like in a mapped file, and
+    then all the data in one write.
+    0 is returned in case of success, 1 in case of failure */
+    char header[FILE_HEADER_SIZE] = {0};
+    _common_fileHeaderInit((_CommonFileHeader*) header, data_size, data_type, size, growth_exponential);
+    if(fwrite(header, FILE_HEADER_SIZE, 1, file) != 1 || fwrite(data, data_size, size, file) != (size_t) size) {
+        printf("couldn't write to the file :(\n");
+        return 1;
+    }
+    return 0;
+}
+
+int _common_loadHeader(FILE *file, _CommonFileHeader *header, int data_size, int data_type) {
+    /* reads and checks the header, after this the file is at the data.
+    0 is returned in case of success, 1 in case of failure */
+    char buffer[FILE_HEADER_SIZE];
+    if(fread(buffer, FILE_HEADER_SIZE, 1, file) != 1) {
+        printf("couldn't read a header from the file\n");
+        return 1;
+    }
+    memcpy(header, buffer, sizeof(_CommonFileHeader));
+    if(_common_fileHeaderCheck(header, data_size, data_type) == 1) return 1;
+    if(header->size > PTRDIFF_MAX / header->data_size) {
+        printf("the file has too many elements\n");
+        return 1;
+    }
+    return 0;
+}
+
+int _common_loadData(FILE *file, ptrdiff_t count, ptrdiff_t chunk_size, int data_size, char **data, ptrdiff_t *size, void *container, int(*grow)(void *container, ptrdiff_t goal_size)) {
+    /* appends count elements from the file to data, which has size
+    elements already. It goes chunk_size elements at a time, and grow
+    only gets asked for room for the next chunk, so a file that lies
+    about its size can't make us allocate more than it actually has.
+    grow can move data, it's looked at again after every call.
+    0 is returned in case of success, 1 in case of failure */
+    ptrdiff_t remaining = count;
+    while(remaining > 0) {
+        ptrdiff_t chunk = remaining < chunk_size ? remaining : chunk_size;
+        if(grow(container, *size + chunk) == 1) {
+            printf("can't load :(\n");
+            return 1;
+        }
+        ptrdiff_t read = fread(*data + *size * data_size, data_size, chunk, file);
+        *size     += read;
+        remaining -= read;
+        if(read < chunk) {
+            printf("the file ended %td elements too early\n", remaining);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+
+
+
+
+
+
+/*--------------- STATS ---------------*/
+/* the global stats are shared by every thread, so they're changed
+atomically. The ones of a container aren't, because only the public
+functions count, and the pool workers of the parallel functions never
+call those, they go through the data directly */
+#ifdef __GNUC__
+#define STATS_ADD(field, amount) __atomic_fetch_add(&(field), (amount), __ATOMIC_RELAXED)
+#define STATS_LOAD(field)        __atomic_load_n(&(field), __ATOMIC_RELAXED)
+#define STATS_MAX(field, value)                                                                         \
+    do {                                                                                                \
+        long _old = __atomic_load_n(&(field), __ATOMIC_RELAXED);                                        \
+        while(_old < (value) && !__atomic_compare_exchange_n(&(field), &_old, (value), true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)); \
+    } while(0)
+#else
+#define STATS_ADD(field, amount) ((field) += (amount))
+#define STATS_LOAD(field)        (field)
+#define STATS_MAX(field, value)  do { if((field) < (value)) (field) = (value); } while(0)
+#endif
+
+EmiStats *_common_statsCreate(void) {
+#ifdef EMI_STATS
+    return (EmiStats*) calloc (1, sizeof(EmiStats));
+#else
+    return NULL;
+#endif
+}
+
+void _common_statsCall(EmiStats *stats, EmiStats *global, int function) {
+    if(stats != NULL) stats->calls[function]++;
+    STATS_ADD(global->calls[function], 1);
+}
+
+void _common_statsResize(EmiStats *stats, EmiStats *global, long old_max_size, long new_max_size) {
+    if(new_max_size > old_max_size) {
+        if(stats != NULL) stats->grows++;
+        STATS_ADD(global->grows, 1);
+    } else if(new_max_size < old_max_size) {
+        if(stats != NULL) stats->shrinks++;
+        STATS_ADD(global->shrinks, 1);
+    }
+    if(stats != NULL && stats->peak_max_size < new_max_size) stats->peak_max_size = new_max_size;
+    STATS_MAX(global->peak_max_size, new_max_size);
+}
+
+void _common_statsMoved(EmiStats *stats, EmiStats *global, long bytes) {
+    if(stats != NULL) stats->bytes_moved += bytes;
+    STATS_ADD(global->bytes_moved, bytes);
+}
+
+void _common_statsCopy(EmiStats *stats, EmiStats *output) {
+    /* a NULL stats gives all zeros */
+    memset(output, 0, sizeof(EmiStats));
+    if(stats == NULL) return;
+    output->grows         = STATS_LOAD(stats->grows);
+    output->shrinks       = STATS_LOAD(stats->shrinks);
+    output->bytes_moved   = STATS_LOAD(stats->bytes_moved);
+    output->peak_max_size = STATS_LOAD(stats->peak_max_size);
+    for(int i=0; i<STATS_MAX_FUNCTIONS; i++)
+        output->calls[i] = STATS_LOAD(stats->calls[i]);
+}
+
+void _common_statsPrint(EmiStats *stats, char *name, const char **function_names, int function_count) {
+#ifndef EMI_STATS
+    printf("%s stats: compiled without EMI_STATS, so there's nothing\n", name);
+    return;
+#endif
+    EmiStats copy;
+    _common_statsCopy(stats, &copy);
+    printf("%s stats: %ld grows, %ld shrinks, %ld bytes moved, room for %ld at most\n", name, copy.grows, copy.shrinks, copy.bytes_moved, copy.peak_max_size);
+    for(int i=0; i<function_count; i++) {
+        if(copy.calls[i] > 0)
+            printf("    %-24s %ld\n", function_names[i], copy.calls[i]);
+    }
+}
+
+
+
+/*--------------- ALLOCATORS ---------------*/
+void *_common_alloc(EmiAllocator *allocator, size_t bytes) {
+    if(allocator == NULL) return malloc(bytes);
+    return allocator->alloc(allocator->context, bytes);
+}
+
+void *_common_realloc(EmiAllocator *allocator, void *pointer, size_t old_bytes, size_t new_bytes) {
+    if(allocator == NULL) return realloc(pointer, new_bytes);
+    return allocator->realloc(allocator->context, pointer, old_bytes, new_bytes);
+}
+
+void _common_free(EmiAllocator *allocator, void *pointer, size_t bytes) {
+    if(allocator == NULL) {
+        free(pointer);
+        return;
+    }
+    allocator->free(allocator->context, pointer, bytes);
+}
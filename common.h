@@ -1,6 +1,11 @@
 #ifndef COMMON_H
 #define COMMON_H
 
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
 
 typedef enum {
     DATA_TYPE_DEF    = 0, /*  any data  */
@@ -24,16 +29,115 @@ typedef enum {
 
 
 
+#define CACHE_LINE_SIZE 64 /* things different threads write to are kept this far apart */
+
+
 /*--------------- ORDER FUNCTIONS ---------------*/
 int _common_defaultOrder   (int datatype, void *a, void *b);
 int _common_charOrder      (void *_a, void *_b);
 int _common_charOrderBlock (char c);
+int _common_intOrder       (void *a, void *b);
+int _common_noOrder        (void *a, void *b);
+int (*_common_orderFunction(int data_type))(void*, void*); /* the default order as a function pointer */
+
+
+
+/*--------------- HASHING FUNCTIONS ---------------*/
+uint64_t _common_mix64     (uint64_t x);
+uint64_t _common_hashBytes (void *data, int data_size);
+uint64_t _common_hash      (void *data, int data_size, int data_type); /* specialized per datatype */
+
+
+
+/*--------------- SORTING FUNCTIONS ---------------*/
+int _common_sort       (char *data, ptrdiff_t length, int data_size, int(*order)(void*, void*)); /* pdqsort, unstable */
+int _common_stableSort (char *data, ptrdiff_t length, int data_size, int(*order)(void*, void*)); /* merge sort */
+int _common_radixSort  (char *data, ptrdiff_t length, int data_size, int data_type);           /* chars, ints and floats only */
+ptrdiff_t _common_mergeSplit (char *left, ptrdiff_t left_length, char *right, ptrdiff_t right_length, ptrdiff_t output_index, int data_size, int(*order)(void*, void*));
+void      _common_merge      (char *left, ptrdiff_t left_length, char *right, ptrdiff_t right_length, char *output, int data_size, int(*order)(void*, void*));
+
+
+
+/*--------------- SEARCHING FUNCTIONS ---------------*/
+ptrdiff_t _common_find     (char *data, ptrdiff_t length, int data_size, void *data_to_find); /* SIMD for sizes 1, 2, 4 and 8 */
+ptrdiff_t _common_count    (char *data, ptrdiff_t length, int data_size, void *data_to_find);
+ptrdiff_t _common_findMany (char *data, ptrdiff_t start, ptrdiff_t length, int data_size, void *data_to_find, ptrdiff_t *indices, ptrdiff_t capacity);
+
+
+
+/*--------------- FILE FUNCTIONS ---------------*/
+/* the header at the start of files that the containers are saved to or
+mapped from. It's written as it is in memory, so files only work on
+machines with the same endianness */
+#define FILE_MAGIC "EMID"
+#define FILE_VERSION 1
+#define FILE_HEADER_SIZE 64 /* the data starts here, so mapped data is nicely aligned */
+#define LOAD_CHUNK_SIZE 65536 /* elements the loads read at once, if they aren't told otherwise */
+
+typedef struct _CommonFileHeader {
+    char     magic[4];
+    uint32_t version;
+    int32_t  data_size;
+    int32_t  data_type;
+    int64_t  size;
+    float    growth_exponential;
+} _CommonFileHeader;
+
+void _common_fileHeaderInit  (_CommonFileHeader *header, int data_size, int data_type, int64_t size, float growth_exponential);
+int  _common_fileHeaderCheck (_CommonFileHeader *header, int data_size, int data_type); /* returns 1 if it doesn't fit, -1 fits anything */
+int  _common_save            (FILE *file, char *data, ptrdiff_t size, int data_size, int data_type, float growth_exponential);
+int  _common_loadHeader      (FILE *file, _CommonFileHeader *header, int data_size, int data_type);
+int  _common_loadData        (FILE *file, ptrdiff_t count, ptrdiff_t chunk_size, int data_size, char **data, ptrdiff_t *size, void *container, int(*grow)(void *container, ptrdiff_t goal_size));
+
+
+
+/*--------------- STATS ---------------*/
+/* only counted when compiled with -DEMI_STATS, otherwise it's all zero.
+Every container has its own, and every type of container has one with
+the totals of the whole process. Only the function that was called
+counts, what it uses on the inside (the _emi_ helpers) doesn't */
+#define STATS_MAX_FUNCTIONS 128
+
+typedef struct EmiStats {
+    long grows;
+    long shrinks;
+    long bytes_moved;   /* by inserting and removing, moving everything after it */
+    long peak_max_size; /* the most elements there has been room for */
+    long calls[STATS_MAX_FUNCTIONS]; /* per function, indexed by the DLIST_CALL_ or DSTACK_CALL_ enums */
+} EmiStats;
+
+EmiStats *_common_statsCreate (void); /* NULL without EMI_STATS */
+void _common_statsCall   (EmiStats *stats, EmiStats *global, int function); /* stats can be NULL */
+void _common_statsResize (EmiStats *stats, EmiStats *global, long old_max_size, long new_max_size);
+void _common_statsMoved  (EmiStats *stats, EmiStats *global, long bytes);
+void _common_statsCopy   (EmiStats *stats, EmiStats *output);
+void _common_statsPrint  (EmiStats *stats, char *name, const char **function_names, int function_count);
+
+
+
+/*--------------- ALLOCATORS ---------------*/
+/* where a dlist or dstack gets its memory from, both the struct and the
+data. The sizes are always given back to it, so an allocator doesn't have
+to remember them. A NULL allocator just means malloc, realloc and free.
+alloc.h has an arena and a blockpool */
+typedef struct EmiAllocator {
+    void *(*alloc)   (void *context, size_t bytes);
+    void *(*realloc) (void *context, void *pointer, size_t old_bytes, size_t new_bytes);
+    void  (*free)    (void *context, void *pointer, size_t bytes);
+    void *context;
+} EmiAllocator;
+
+void *_common_alloc   (EmiAllocator *allocator, size_t bytes);
+void *_common_realloc (EmiAllocator *allocator, void *pointer, size_t old_bytes, size_t new_bytes);
+void  _common_free    (EmiAllocator *allocator, void *pointer, size_t bytes);
 
 
 
 /*--------------- UTILITY FUNCTIONS ---------------*/
-void _common_fixIndex          (int size, int *index);
-void _common_fixIndexInclusive (int size, int *index);
+void _common_fixIndex          (ptrdiff_t size, ptrdiff_t *index);
+void _common_fixIndexInclusive (ptrdiff_t size, ptrdiff_t *index);
+int  _common_checkedBytes      (ptrdiff_t count, int data_size, size_t *bytes); /* returns 1 if count * data_size overflows */
+ptrdiff_t _common_grownSize    (ptrdiff_t max_size, float growth_exponential, ptrdiff_t goal_size, int data_size);
 int  _common_sizeof            (int datatype);
 void _common_printData         (void* data, int data_size, int data_type);
 
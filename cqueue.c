@@ -0,0 +1,291 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <sched.h>
+
+#include "cqueue.h"
+#include "common.h"
+
+
+/*--------------- INTERNAL FUNCTIONS ---------------*/
+size_t _emi_cqueue_powerOfTwo(int size) {
+    size_t power = 1;
+    while(power < (size_t) size) power *= 2;
+    return power;
+}
+
+void *_emi_cqueue_alignedAlloc(size_t size) {
+    /* aligned_alloc wants the size to be a multiple of the alignment */
+    size = (size + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE;
+    return aligned_alloc(CACHE_LINE_SIZE, size);
+}
+
+void _emi_cqueue_spin(int *spins) {
+    /* for the short waits in the batch functions. If the other thread
+    takes long, it probably isn't running, so give it our time */
+    if(++(*spins) > 64) {
+        sched_yield();
+        return;
+    }
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+}
+
+
+
+
+
+
+
+/*--------------- SPSC FUNCTIONS ---------------*/
+Spscqueue *emi_spscqueue_create(int data_size, int data_type, int max_size) {
+    Spscqueue *new_queue = (Spscqueue*) _emi_cqueue_alignedAlloc(sizeof(Spscqueue));
+    if(new_queue == NULL) {
+        printf("malloc failed in emi_spscqueue_create :(\n");
+        return NULL;
+    }
+    new_queue->max_size  = _emi_cqueue_powerOfTwo(max_size);
+    new_queue->data      = (char*) _emi_cqueue_alignedAlloc(new_queue->max_size * data_size);
+    if(new_queue->data == NULL) {
+        printf("malloc failed in emi_spscqueue_create :(\n");
+        free(new_queue);
+        return NULL;
+    }
+    new_queue->data_size = data_size;
+    new_queue->data_type = data_type;
+    atomic_init(&new_queue->head, 0);
+    atomic_init(&new_queue->tail, 0);
+    new_queue->cached_head = 0;
+    new_queue->cached_tail = 0;
+    return new_queue;
+}
+
+
+int emi_spscqueue_push(Spscqueue *queue, void *data) {
+    /* only call this from the producer thread */
+    return emi_spscqueue_pushArray(queue, data, 1) == 1 ? 0 : 1;
+}
+
+int emi_spscqueue_pop(Spscqueue *queue, void *output) {
+    /* only call this from the consumer thread */
+    return emi_spscqueue_popArray(queue, output, 1) == 1 ? 0 : 1;
+}
+
+
+int emi_spscqueue_pushArray(Spscqueue *queue, void *data, int array_length) {
+    /* pushes as many as fit, with at most two memcpys and one atomic store */
+    if(array_length <= 0) return 0;
+    size_t tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+
+    /* head only ever moves forward, so if the old value says there's
+    room, there is. Only if it doesn't we look at the real one */
+    size_t room = queue->max_size - (tail - queue->cached_head);
+    if(room < (size_t) array_length) {
+        queue->cached_head = atomic_load_explicit(&queue->head, memory_order_acquire);
+        room = queue->max_size - (tail - queue->cached_head);
+    }
+    if((size_t) array_length > room) array_length = room;
+    if(array_length == 0) return 0;
+
+    size_t position = tail & (queue->max_size - 1);
+    size_t first = queue->max_size - position;
+    if(first > (size_t) array_length) first = array_length;
+    memcpy(queue->data + position * queue->data_size, data, first * queue->data_size);
+    memcpy(queue->data, (char*) data + first * queue->data_size, (array_length - first) * queue->data_size);
+
+    atomic_store_explicit(&queue->tail, tail + array_length, memory_order_release);
+    return array_length;
+}
+
+int emi_spscqueue_popArray(Spscqueue *queue, void *output, int array_length) {
+    if(array_length <= 0) return 0;
+    size_t head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+
+    size_t available = queue->cached_tail - head;
+    if(available < (size_t) array_length) {
+        queue->cached_tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+        available = queue->cached_tail - head;
+    }
+    if((size_t) array_length > available) array_length = available;
+    if(array_length == 0) return 0;
+
+    size_t position = head & (queue->max_size - 1);
+    size_t first = queue->max_size - position;
+    if(first > (size_t) array_length) first = array_length;
+    memcpy(output, queue->data + position * queue->data_size, first * queue->data_size);
+    memcpy((char*) output + first * queue->data_size, queue->data, (array_length - first) * queue->data_size);
+
+    atomic_store_explicit(&queue->head, head + array_length, memory_order_release);
+    return array_length;
+}
+
+
+int emi_spscqueue_size(Spscqueue *queue) {
+    size_t head = atomic_load_explicit(&queue->head, memory_order_acquire);
+    size_t tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+    return tail - head;
+}
+
+void emi_spscqueue_free(Spscqueue *queue) {
+    free(queue->data);
+    free(queue);
+    return;
+}
+
+
+
+
+
+
+
+/*--------------- MPMC FUNCTIONS ---------------*/
+/* every cell has a sequence number. A cell at position p is free for the
+producer of p when its sequence is p, and full for the consumer of p when
+its sequence is p+1. The consumer then sets it to p+max_size, which is
+the next time a producer comes around to it */
+atomic_size_t *_emi_mpmcqueue_sequence(Mpmcqueue *queue, size_t position) {
+    return (atomic_size_t*) (queue->cells + (position & (queue->max_size - 1)) * queue->cell_size);
+}
+
+char *_emi_mpmcqueue_data(Mpmcqueue *queue, size_t position) {
+    return queue->cells + (position & (queue->max_size - 1)) * queue->cell_size + sizeof(atomic_size_t);
+}
+
+
+Mpmcqueue *emi_mpmcqueue_create(int data_size, int data_type, int max_size) {
+    Mpmcqueue *new_queue = (Mpmcqueue*) _emi_cqueue_alignedAlloc(sizeof(Mpmcqueue));
+    if(new_queue == NULL) {
+        printf("malloc failed in emi_mpmcqueue_create :(\n");
+        return NULL;
+    }
+    new_queue->data_size = data_size;
+    new_queue->data_type = data_type;
+    new_queue->max_size  = _emi_cqueue_powerOfTwo(max_size < 2 ? 2 : max_size);
+    new_queue->cell_size = (sizeof(atomic_size_t) + data_size + sizeof(atomic_size_t) - 1) / sizeof(atomic_size_t) * sizeof(atomic_size_t);
+    new_queue->cells     = (char*) _emi_cqueue_alignedAlloc(new_queue->max_size * new_queue->cell_size);
+    if(new_queue->cells == NULL) {
+        printf("malloc failed in emi_mpmcqueue_create :(\n");
+        free(new_queue);
+        return NULL;
+    }
+    for(size_t i=0; i<new_queue->max_size; i++)
+        atomic_init(_emi_mpmcqueue_sequence(new_queue, i), i);
+    atomic_init(&new_queue->enqueue_position, 0);
+    atomic_init(&new_queue->dequeue_position, 0);
+    return new_queue;
+}
+
+
+int emi_mpmcqueue_push(Mpmcqueue *queue, void *data) {
+    size_t position = atomic_load_explicit(&queue->enqueue_position, memory_order_relaxed);
+    while(true) {
+        atomic_size_t *sequence = _emi_mpmcqueue_sequence(queue, position);
+        intptr_t difference = (intptr_t) atomic_load_explicit(sequence, memory_order_acquire) - (intptr_t) position;
+
+        if(difference == 0) {
+            /* the cell is free, try to claim the position. If that fails,
+            position gets updated to the current one */
+            if(atomic_compare_exchange_weak_explicit(&queue->enqueue_position, &position, position + 1, memory_order_relaxed, memory_order_relaxed))
+                break;
+        } else if(difference < 0) {
+            return 1; /* the consumer from a lap ago isn't done, so we're full */
+        } else {
+            position = atomic_load_explicit(&queue->enqueue_position, memory_order_relaxed);
+        }
+    }
+
+    memcpy(_emi_mpmcqueue_data(queue, position), data, queue->data_size);
+    atomic_store_explicit(_emi_mpmcqueue_sequence(queue, position), position + 1, memory_order_release);
+    return 0;
+}
+
+int emi_mpmcqueue_pop(Mpmcqueue *queue, void *output) {
+    size_t position = atomic_load_explicit(&queue->dequeue_position, memory_order_relaxed);
+    while(true) {
+        atomic_size_t *sequence = _emi_mpmcqueue_sequence(queue, position);
+        intptr_t difference = (intptr_t) atomic_load_explicit(sequence, memory_order_acquire) - (intptr_t) (position + 1);
+
+        if(difference == 0) {
+            if(atomic_compare_exchange_weak_explicit(&queue->dequeue_position, &position, position + 1, memory_order_relaxed, memory_order_relaxed))
+                break;
+        } else if(difference < 0) {
+            return 1; /* nothing has been pushed here yet, so we're empty */
+        } else {
+            position = atomic_load_explicit(&queue->dequeue_position, memory_order_relaxed);
+        }
+    }
+
+    memcpy(output, _emi_mpmcqueue_data(queue, position), queue->data_size);
+    atomic_store_explicit(_emi_mpmcqueue_sequence(queue, position), position + queue->max_size, memory_order_release);
+    return 0;
+}
+
+
+int emi_mpmcqueue_pushArray(Mpmcqueue *queue, void *data, int array_length) {
+    /* claims a whole range of positions with one compare and swap. The
+    consumers of those cells from the previous lap have all claimed them
+    already, but they might still be copying, so we wait per cell until
+    it's ours. Returns how many were pushed */
+    if(array_length <= 0) return 0;
+    size_t position = atomic_load_explicit(&queue->enqueue_position, memory_order_relaxed);
+    size_t count;
+    do {
+        size_t dequeued = atomic_load_explicit(&queue->dequeue_position, memory_order_acquire);
+        size_t used = position - dequeued;
+        if((intptr_t) used < 0) used = 0; /* dequeue_position was newer than our position */
+        count = used < queue->max_size ? queue->max_size - used : 0;
+        if(count > (size_t) array_length) count = array_length;
+        if(count == 0) return 0;
+    } while(!atomic_compare_exchange_weak_explicit(&queue->enqueue_position, &position, position + count, memory_order_relaxed, memory_order_relaxed));
+
+    for(size_t i=0; i<count; i++) {
+        atomic_size_t *sequence = _emi_mpmcqueue_sequence(queue, position + i);
+        int spins = 0;
+        while(atomic_load_explicit(sequence, memory_order_acquire) != position + i)
+            _emi_cqueue_spin(&spins);
+        memcpy(_emi_mpmcqueue_data(queue, position + i), (char*) data + i * queue->data_size, queue->data_size);
+        atomic_store_explicit(sequence, position + i + 1, memory_order_release);
+    }
+    return count;
+}
+
+int emi_mpmcqueue_popArray(Mpmcqueue *queue, void *output, int array_length) {
+    /* same idea, the range is claimed at once, and then we wait per cell
+    for its producer to be done. Returns how many were popped */
+    if(array_length <= 0) return 0;
+    size_t position = atomic_load_explicit(&queue->dequeue_position, memory_order_relaxed);
+    size_t count;
+    do {
+        size_t enqueued = atomic_load_explicit(&queue->enqueue_position, memory_order_acquire);
+        count = (intptr_t) (enqueued - position) > 0 ? enqueued - position : 0;
+        if(count > (size_t) array_length) count = array_length;
+        if(count == 0) return 0;
+    } while(!atomic_compare_exchange_weak_explicit(&queue->dequeue_position, &position, position + count, memory_order_relaxed, memory_order_relaxed));
+
+    for(size_t i=0; i<count; i++) {
+        atomic_size_t *sequence = _emi_mpmcqueue_sequence(queue, position + i);
+        int spins = 0;
+        while(atomic_load_explicit(sequence, memory_order_acquire) != position + i + 1)
+            _emi_cqueue_spin(&spins);
+        memcpy((char*) output + i * queue->data_size, _emi_mpmcqueue_data(queue, position + i), queue->data_size);
+        atomic_store_explicit(sequence, position + i + queue->max_size, memory_order_release);
+    }
+    return count;
+}
+
+
+int emi_mpmcqueue_size(Mpmcqueue *queue) {
+    size_t dequeued = atomic_load_explicit(&queue->dequeue_position, memory_order_acquire);
+    size_t enqueued = atomic_load_explicit(&queue->enqueue_position, memory_order_acquire);
+    return (intptr_t) (enqueued - dequeued) > 0 ? (int) (enqueued - dequeued) : 0;
+}
+
+void emi_mpmcqueue_free(Mpmcqueue *queue) {
+    free(queue->cells);
+    free(queue);
+    return;
+}
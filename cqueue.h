@@ -0,0 +1,81 @@
+/* concurrent queue library, bounded queues that several threads
+can use at the same time without any locks
+
+  ____
+ /    \
+| _  _ |
+|      |
+ \    /
+  \  /
+   \/
+
+
+
+there are two of them:
+spscqueue: exactly one thread pushes, and exactly one thread pops.
+           Both sides are wait-free
+mpmcqueue: any amount of threads push and pop. Every slot has a
+           sequence number which says whose turn it is (dmitry vyukov's
+           bounded queue)
+both have a fixed size, which is rounded up to a power of two, and
+pushing to a full queue just fails instead of growing
+*/
+
+
+
+#ifndef CQUEUE_H
+#define CQUEUE_H
+
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#include "common.h"
+
+
+/*--------------- STRUCTS ---------------*/
+typedef struct Spscqueue {
+    _Alignas(CACHE_LINE_SIZE) atomic_size_t head; /* only the consumer writes this */
+    size_t cached_tail;                             /* what the consumer last saw of tail */
+    _Alignas(CACHE_LINE_SIZE) atomic_size_t tail; /* only the producer writes this */
+    size_t cached_head;
+    _Alignas(CACHE_LINE_SIZE) int data_size;      /* nobody writes these after creation */
+    int data_type;
+    size_t max_size;
+    char *data;
+} Spscqueue;
+
+typedef struct Mpmcqueue {
+    _Alignas(CACHE_LINE_SIZE) atomic_size_t enqueue_position;
+    _Alignas(CACHE_LINE_SIZE) atomic_size_t dequeue_position;
+    _Alignas(CACHE_LINE_SIZE) int data_size;
+    int data_type;
+    size_t max_size;
+    size_t cell_size; /* a sequence number and the data */
+    char *cells;
+} Mpmcqueue;
+
+/*--------------- ENUMS ---------------*/
+
+
+
+
+/*--------------- SPSC FUNCTIONS ---------------*/
+Spscqueue *emi_spscqueue_create    (int data_size, int data_type, int max_size);
+int        emi_spscqueue_push      (Spscqueue *queue, void *data);   /* returns 1 if it's full */
+int        emi_spscqueue_pop       (Spscqueue *queue, void *output); /* returns 1 if it's empty */
+int        emi_spscqueue_pushArray (Spscqueue *queue, void *data,   int array_length); /* returns how many were pushed */
+int        emi_spscqueue_popArray  (Spscqueue *queue, void *output, int array_length); /* returns how many were popped */
+int        emi_spscqueue_size      (Spscqueue *queue); /* only a snapshot */
+void       emi_spscqueue_free      (Spscqueue *queue);
+
+/*--------------- MPMC FUNCTIONS ---------------*/
+Mpmcqueue *emi_mpmcqueue_create    (int data_size, int data_type, int max_size);
+int        emi_mpmcqueue_push      (Mpmcqueue *queue, void *data);
+int        emi_mpmcqueue_pop       (Mpmcqueue *queue, void *output);
+int        emi_mpmcqueue_pushArray (Mpmcqueue *queue, void *data,   int array_length);
+int        emi_mpmcqueue_popArray  (Mpmcqueue *queue, void *output, int array_length);
+int        emi_mpmcqueue_size      (Mpmcqueue *queue);
+void       emi_mpmcqueue_free      (Mpmcqueue *queue);
+
+#endif
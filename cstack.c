@@ -0,0 +1,270 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdatomic.h>
+
+#include "cstack.h"
+#include "common.h"
+
+
+/*--------------- INTERNAL FUNCTIONS ---------------*/
+/* the top, the free list and the elimination slots are all an index in
+the low 32 bits and a tag in the high 32 bits */
+#define CSTACK_NONE  0xffffffffu /* no node, so the end of a list or an empty slot */
+#define CSTACK_TAKEN 0xfffffffeu /* a pop took the node from an elimination slot */
+
+uint64_t _emi_cstack_pack(uint32_t index, uint64_t old) {
+    /* the index with the tag of old plus one */
+    return ((old >> 32) + 1) << 32 | index;
+}
+
+uint32_t _emi_cstack_index(uint64_t value) {
+    return (uint32_t) value;
+}
+
+_Atomic uint32_t *_emi_cstack_next(Cstack *cstack, uint32_t index) {
+    return (_Atomic uint32_t*) (cstack->nodes + (size_t) index * cstack->node_size);
+}
+
+char *_emi_cstack_data(Cstack *cstack, uint32_t index) {
+    return cstack->nodes + (size_t) index * cstack->node_size + sizeof(uint64_t);
+}
+
+void _emi_cstack_spin(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+}
+
+
+/* both lists work the same, so these take the list they work on. The next
+of a node can be read by a thread whose compare and swap is going to
+fail anyway, which is why it's atomic too */
+void _emi_cstack_link(Cstack *cstack, _Atomic uint64_t *list, uint32_t first, uint32_t last) {
+    /* puts the chain from first to last on the list, with one compare and swap */
+    uint64_t old = atomic_load_explicit(list, memory_order_relaxed);
+    do {
+        atomic_store_explicit(_emi_cstack_next(cstack, last), _emi_cstack_index(old), memory_order_relaxed);
+    } while(!atomic_compare_exchange_weak_explicit(list, &old, _emi_cstack_pack(first, old), memory_order_release, memory_order_relaxed));
+}
+
+bool _emi_cstack_tryUnlink(Cstack *cstack, _Atomic uint64_t *list, uint64_t *old, uint32_t *index) {
+    /* one attempt at taking the first node off the list. If it fails, old
+    is the new value of the list, which the elimination uses */
+    *index = _emi_cstack_index(*old);
+    if(*index == CSTACK_NONE) return false;
+    uint32_t next = atomic_load_explicit(_emi_cstack_next(cstack, *index), memory_order_relaxed);
+    return atomic_compare_exchange_weak_explicit(list, old, _emi_cstack_pack(next, *old), memory_order_acquire, memory_order_acquire);
+}
+
+uint32_t _emi_cstack_unlink(Cstack *cstack, _Atomic uint64_t *list) {
+    /* takes the first node off the list, CSTACK_NONE if there isn't one */
+    uint64_t old = atomic_load_explicit(list, memory_order_acquire);
+    uint32_t index;
+    while(!_emi_cstack_tryUnlink(cstack, list, &old, &index)) {
+        if(index == CSTACK_NONE) return CSTACK_NONE;
+    }
+    return index;
+}
+
+
+_Atomic uint64_t *_emi_cstack_slot(Cstack *cstack, uint64_t top) {
+    /* threads that failed on the same top end up at the same slot, which
+    is where they have the best chance to meet */
+    return &cstack->elimination[_common_mix64(top) & (ELIMINATION_SIZE - 1)];
+}
+
+bool _emi_cstack_eliminatePush(Cstack *cstack, uint32_t index, uint64_t top) {
+    /* leaves the node in a slot for a while. true if a pop took it */
+    _Atomic uint64_t *slot = _emi_cstack_slot(cstack, top);
+    uint64_t old = atomic_load_explicit(slot, memory_order_relaxed);
+    if(_emi_cstack_index(old) != CSTACK_NONE) return false;
+    uint64_t offer = _emi_cstack_pack(index, old);
+    if(!atomic_compare_exchange_strong_explicit(slot, &old, offer, memory_order_release, memory_order_relaxed))
+        return false;
+
+    for(int i=0; i<ELIMINATION_SPINS; i++) {
+        if(atomic_load_explicit(slot, memory_order_relaxed) != offer) break;
+        _emi_cstack_spin();
+    }
+    /* take the offer back. If that fails, a pop has taken the node, and
+    the slot is ours to empty again */
+    uint64_t expected = offer;
+    if(atomic_compare_exchange_strong_explicit(slot, &expected, _emi_cstack_pack(CSTACK_NONE, offer), memory_order_relaxed, memory_order_relaxed))
+        return false;
+    atomic_store_explicit(slot, _emi_cstack_pack(CSTACK_NONE, expected), memory_order_relaxed);
+    return true;
+}
+
+uint32_t _emi_cstack_eliminatePop(Cstack *cstack, uint64_t top) {
+    /* takes a node that a push left in a slot, CSTACK_NONE if there isn't one */
+    _Atomic uint64_t *slot = _emi_cstack_slot(cstack, top);
+    uint64_t old = atomic_load_explicit(slot, memory_order_relaxed);
+    uint32_t index = _emi_cstack_index(old);
+    if(index == CSTACK_NONE || index == CSTACK_TAKEN) return CSTACK_NONE;
+    if(!atomic_compare_exchange_strong_explicit(slot, &old, _emi_cstack_pack(CSTACK_TAKEN, old), memory_order_acquire, memory_order_relaxed))
+        return CSTACK_NONE;
+    return index;
+}
+
+
+
+
+
+
+
+
+/*--------------- CREATION FUNCTIONS ---------------*/
+Cstack *emi_cstack_create(int data_size, int data_type, int max_size) {
+    if(max_size < 1) max_size = 1;
+    if((uint32_t) max_size >= CSTACK_TAKEN) {
+        printf("a cstack can't hold %d elements\n", max_size);
+        return NULL;
+    }
+
+    /* the struct is aligned to the cache line, and aligned_alloc wants
+    the size to be a multiple of that */
+    size_t struct_size = (sizeof(Cstack) + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE;
+    Cstack *new_cstack = (Cstack*) aligned_alloc(CACHE_LINE_SIZE, struct_size);
+    if(new_cstack == NULL) {
+        printf("malloc failed in emi_cstack_create :(\n");
+        return NULL;
+    }
+    new_cstack->data_size = data_size;
+    new_cstack->data_type = data_type;
+    new_cstack->max_size  = max_size;
+    new_cstack->node_size = (sizeof(uint64_t) + data_size + sizeof(uint64_t) - 1) / sizeof(uint64_t) * sizeof(uint64_t);
+    new_cstack->nodes     = (char*) malloc ((size_t) max_size * new_cstack->node_size);
+    if(new_cstack->nodes == NULL) {
+        printf("malloc failed in emi_cstack_create :(\n");
+        free(new_cstack);
+        return NULL;
+    }
+
+    /* at first, every node is free, in order */
+    for(int i=0; i<max_size; i++)
+        atomic_init(_emi_cstack_next(new_cstack, i), i + 1 < max_size ? (uint32_t) i + 1 : CSTACK_NONE);
+    atomic_init(&new_cstack->free_nodes, 0);
+    atomic_init(&new_cstack->top, CSTACK_NONE);
+    atomic_init(&new_cstack->size, 0);
+    for(int i=0; i<ELIMINATION_SIZE; i++)
+        atomic_init(&new_cstack->elimination[i], CSTACK_NONE);
+
+    return new_cstack;
+}
+
+
+
+
+/*--------------- POPPING FUNCTIONS ---------------*/
+void *emi_cstack_pop(Cstack *cstack) {
+    char *output = (char *) malloc (cstack->data_size);
+    if(output == NULL) {
+        printf("malloc failed in emi_cstack_pop :(\n");
+        return NULL;
+    }
+    if(emi_cstack_popInto(cstack, output) == 1) {
+        free(output);
+        return NULL;
+    }
+    return output;
+}
+
+int emi_cstack_popInto(Cstack *cstack, void *output) {
+    /* 0 is returned in case of success, 1 if it was empty. Unlike dstack,
+    an empty cstack isn't an error, other threads might just be slow */
+    uint64_t top = atomic_load_explicit(&cstack->top, memory_order_acquire);
+    uint32_t index;
+    bool eliminated = false;
+    while(!_emi_cstack_tryUnlink(cstack, &cstack->top, &top, &index)) {
+        if(index == CSTACK_NONE) return 1;
+        /* someone else changed the top, maybe it was a push we can meet */
+        index = _emi_cstack_eliminatePop(cstack, top);
+        if(index != CSTACK_NONE) {
+            eliminated = true;
+            break;
+        }
+    }
+
+    memcpy(output, _emi_cstack_data(cstack, index), cstack->data_size);
+    if(!eliminated) atomic_fetch_sub_explicit(&cstack->size, 1, memory_order_relaxed);
+    _emi_cstack_link(cstack, &cstack->free_nodes, index, index);
+    return 0;
+}
+
+
+
+
+/*--------------- PUSHING FUNCTIONS ---------------*/
+int emi_cstack_push(Cstack *cstack, void *data) {
+    uint32_t index = _emi_cstack_unlink(cstack, &cstack->free_nodes);
+    if(index == CSTACK_NONE) return 1;
+    memcpy(_emi_cstack_data(cstack, index), data, cstack->data_size);
+
+    _Atomic uint32_t *next = _emi_cstack_next(cstack, index);
+    uint64_t top = atomic_load_explicit(&cstack->top, memory_order_relaxed);
+    while(true) {
+        atomic_store_explicit(next, _emi_cstack_index(top), memory_order_relaxed);
+        if(atomic_compare_exchange_weak_explicit(&cstack->top, &top, _emi_cstack_pack(index, top), memory_order_release, memory_order_relaxed))
+            break;
+        /* a pop that took it from the elimination array frees it as well */
+        if(_emi_cstack_eliminatePush(cstack, index, top)) return 0;
+        top = atomic_load_explicit(&cstack->top, memory_order_relaxed);
+    }
+    atomic_fetch_add_explicit(&cstack->size, 1, memory_order_relaxed);
+    return 0;
+}
+
+int emi_cstack_pushArray(Cstack *cstack, void *data, int array_length) {
+    /* takes as many free nodes as it can get, chains them together, and
+    puts the whole chain on top with one compare and swap, so the
+    elements of the array stay together */
+    uint32_t first = CSTACK_NONE, last = CSTACK_NONE;
+    int count = 0;
+    while(count < array_length) {
+        uint32_t index = _emi_cstack_unlink(cstack, &cstack->free_nodes);
+        if(index == CSTACK_NONE) break;
+        memcpy(_emi_cstack_data(cstack, index), (char*) data + (size_t) count * cstack->data_size, cstack->data_size);
+        /* the chain is built from the bottom up, so the new node goes first */
+        if(last == CSTACK_NONE) last = index;
+        else atomic_store_explicit(_emi_cstack_next(cstack, index), first, memory_order_relaxed);
+        first = index;
+        count++;
+    }
+    if(count == 0) return 0;
+
+    _emi_cstack_link(cstack, &cstack->top, first, last);
+    atomic_fetch_add_explicit(&cstack->size, count, memory_order_relaxed);
+    return count;
+}
+
+
+
+
+/*--------------- UTILITY FUNCTIONS ---------------*/
+int emi_cstack_size(Cstack *cstack) {
+    /* the counter is changed after the top, so for a moment it can be off,
+    and even below zero */
+    int size = atomic_load_explicit(&cstack->size, memory_order_relaxed);
+    return size < 0 ? 0 : size;
+}
+
+int emi_cstack_dataSize(Cstack *cstack) {
+    return cstack->data_size;
+}
+
+bool emi_cstack_isEmpty(Cstack *cstack) {
+    return _emi_cstack_index(atomic_load_explicit(&cstack->top, memory_order_relaxed)) == CSTACK_NONE;
+}
+
+
+
+
+/*--------------- MEMORY MANAGEMENT FUNCTIONS ---------------*/
+void emi_cstack_free(Cstack *cstack) {
+    free(cstack->nodes);
+    free(cstack);
+    return;
+}
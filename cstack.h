@@ -0,0 +1,83 @@
+/* concurrent stack library, a stack that several threads can push to
+and pop from at the same time without any locks
+
+  ____
+ /    \
+| _  _ |
+|      |
+ \    /
+  \  /
+   \/
+
+
+
+it's a treiber stack: the elements are nodes which point to the one
+below them, and pushing or popping is one compare and swap on the top.
+The nodes come from a pool that's made at creation, so it has a fixed
+size like the cqueues, and pushing to a full cstack just fails.
+
+the top and the list of free nodes are an index with a tag next to it,
+which goes up on every change, so a node that got popped and pushed
+again in the meantime doesn't fool a compare and swap (ABA).
+
+when a lot of threads fight over the top, a push and a pop can also
+meet in the elimination array: the push leaves its node in a slot,
+and the pop takes it from there, without either of them touching the
+top at all
+*/
+
+
+
+#ifndef CSTACK_H
+#define CSTACK_H
+
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include "common.h"
+
+
+/*--------------- DEFINES ---------------*/
+#define ELIMINATION_SIZE 8    /* slots in the elimination array, a power of two */
+#define ELIMINATION_SPINS 128 /* how long a push waits in a slot for a pop to come by */
+
+
+/*--------------- STRUCTS ---------------*/
+typedef struct Cstack {
+    _Alignas(CACHE_LINE_SIZE) _Atomic uint64_t top;        /* tag << 32 | index of the top node */
+    _Alignas(CACHE_LINE_SIZE) _Atomic uint64_t free_nodes; /* same, but for the unused nodes */
+    _Alignas(CACHE_LINE_SIZE) atomic_int size;
+    _Alignas(CACHE_LINE_SIZE) _Atomic uint64_t elimination[ELIMINATION_SIZE];
+    _Alignas(CACHE_LINE_SIZE) int data_size; /* nobody writes these after creation */
+    int data_type;
+    int max_size;
+    int node_size; /* the index of the next node and the data */
+    char *nodes;
+} Cstack;
+
+/*--------------- ENUMS ---------------*/
+
+
+
+
+/*--------------- CREATION FUNCTIONS ---------------*/
+Cstack *emi_cstack_create     (int data_size, int data_type, int max_size);
+
+/*--------------- POPPING FUNCTIONS ---------------*/
+void   *emi_cstack_pop        (Cstack *cstack);
+int     emi_cstack_popInto    (Cstack *cstack, void *output); /* no malloc, returns 1 if it's empty */
+
+/*--------------- PUSHING FUNCTIONS ---------------*/
+int     emi_cstack_push       (Cstack *cstack, void *data); /* returns 1 if it's full */
+int     emi_cstack_pushArray  (Cstack *cstack, void *data, int array_length); /* returns how many were pushed, the last one ends up on top */
+
+/*--------------- UTILITY FUNCTIONS ---------------*/
+int     emi_cstack_size       (Cstack *cstack); /* only an estimate while others push and pop */
+int     emi_cstack_dataSize   (Cstack *cstack);
+bool    emi_cstack_isEmpty    (Cstack *cstack);
+
+/*--------------- MEMORY MANAGEMENT FUNCTIONS ---------------*/
+void    emi_cstack_free       (Cstack *cstack); /* nobody can be using it anymore */
+
+#endif
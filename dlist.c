@@ -1,14 +1,269 @@
+#define _GNU_SOURCE /* for mremap */
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
 #include <string.h>
+#include <limits.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "dlist.h"
 #include "common.h"
 
 
+/*--------------- STATS ---------------*/
+EmiStats _emi_dlist_global_stats;
+
+#define _EMI_DLIST_NAME(name) #name,
+const char *_emi_dlist_function_names[] = { EMI_DLIST_FUNCTIONS(_EMI_DLIST_NAME) };
+
+_Static_assert(DLIST_CALL_COUNT <= STATS_MAX_FUNCTIONS, "STATS_MAX_FUNCTIONS is too small for every dlist function");
+
+#ifdef EMI_STATS
+#define STATS_CALL(dlist, function) _common_statsCall((dlist)->stats, &_emi_dlist_global_stats, DLIST_CALL_##function)
+#define STATS_CALL_GLOBAL(function) _common_statsCall(NULL, &_emi_dlist_global_stats, DLIST_CALL_##function)
+#define STATS_RESIZE(dlist, old_max_size) _common_statsResize((dlist)->stats, &_emi_dlist_global_stats, old_max_size, (dlist)->max_size)
+#define STATS_MOVED(dlist, bytes) _common_statsMoved((dlist)->stats, &_emi_dlist_global_stats, bytes)
+#else
+#define STATS_CALL(dlist, function)
+#define STATS_CALL_GLOBAL(function)
+#define STATS_RESIZE(dlist, old_max_size) (void) (old_max_size)
+#define STATS_MOVED(dlist, bytes)
+#endif
+
+
+
+
 /*--------------- INTERNAL FUNCTIONS ---------------*/
-int _emi_dlist_grow(Dlist *dlist, int goal_size) {
+typedef struct _EmiDlistShared {
+    /* the data of copy-on-write dlists. Every dlist that uses it has a
+    reference, and its data points somewhere inside it. Whoever drops
+    the last reference frees it */
+    long refs; /* changed atomically, the dlists can be on other threads */
+    char *data;
+    size_t bytes;
+    EmiAllocator *allocator;
+} _EmiDlistShared;
+
+void _emi_dlist_release(_EmiDlistShared *shared) {
+    if(__atomic_sub_fetch(&shared->refs, 1, __ATOMIC_ACQ_REL) > 0) return;
+    _common_free(shared->allocator, shared->data, shared->bytes);
+    _common_free(shared->allocator, shared, sizeof(_EmiDlistShared));
+}
+
+bool _emi_dlist_takeShared(Dlist *dlist) {
+    /* if nobody else uses the shared data anymore and this dlist covers
+    all of it, it just becomes the dlist's own data again */
+    _EmiDlistShared *shared = dlist->shared;
+    if(__atomic_load_n(&shared->refs, __ATOMIC_ACQUIRE) != 1) return false;
+    if(dlist->data != shared->data || (size_t) dlist->max_size * dlist->data_size != shared->bytes) return false;
+    _common_free(shared->allocator, shared, sizeof(_EmiDlistShared));
+    dlist->shared = NULL;
+    return true;
+}
+
+int _emi_dlist_unshare(Dlist *dlist, ptrdiff_t new_max_size) {
+    /* copies the elements out of the shared data into data of its own,
+    with room for new_max_size of them (which is at least the size).
+    0 is returned in case of success, 1 in case of failure */
+    size_t new_bytes = (size_t) new_max_size * dlist->data_size;
+    char *new_location = new_bytes <= (size_t) dlist->inline_bytes ? dlist->inline_data : (char*) _common_alloc(dlist->allocator, new_bytes);
+    if(new_location == NULL) return 1;
+    memcpy(new_location, dlist->data, (size_t) dlist->size * dlist->data_size);
+    _emi_dlist_release(dlist->shared);
+    dlist->shared   = NULL;
+    dlist->data     = new_location;
+    dlist->max_size = new_max_size;
+    return 0;
+}
+
+_CommonFileHeader *_emi_dlist_header(Dlist *dlist) {
+    /* only for mapped dlists, the header is right before the data */
+    return (_CommonFileHeader*) (dlist->data - FILE_HEADER_SIZE);
+}
+
+int _emi_dlist_remap(Dlist *dlist, ptrdiff_t new_max_size) {
+    /* makes the file and the mapping fit new_max_size elements.
+    0 is returned in case of success, 1 in case of failure */
+    if(dlist->flags & MAPPED_READONLY) {
+        printf("can't resize a read only mapped dlist\n");
+        return 1;
+    }
+    size_t old_length = FILE_HEADER_SIZE + (size_t) dlist->max_size * dlist->data_size;
+    size_t new_length = FILE_HEADER_SIZE + (size_t) new_max_size    * dlist->data_size;
+    char *mapping = dlist->data - FILE_HEADER_SIZE;
+
+    /* the file has to be big enough before the mapping is, and the
+    mapping small enough before the file is */
+    if(new_length > old_length && ftruncate(dlist->fd, new_length) == -1) {
+        printf("couldn't make the file bigger :(\n");
+        return 1;
+    }
+#ifdef MREMAP_MAYMOVE
+    char *new_mapping = (char*) mremap(mapping, old_length, new_length, MREMAP_MAYMOVE);
+#else
+    /* the old mapping stays until the new one is there, so a failure
+    leaves the dlist as it was */
+    char *new_mapping = (char*) mmap(NULL, new_length, PROT_READ | PROT_WRITE, MAP_SHARED, dlist->fd, 0);
+    if(new_mapping != MAP_FAILED) munmap(mapping, old_length);
+#endif
+    if(new_mapping == MAP_FAILED) {
+        printf("couldn't map %zu bytes :(\n", new_length);
+        return 1;
+    }
+    /* the mapping is already smaller at this point, so if this fails the
+    file just keeps some bytes at the end that nothing uses */
+    if(new_length < old_length && ftruncate(dlist->fd, new_length) == -1)
+        printf("couldn't make the file smaller :(\n");
+
+    dlist->data = new_mapping + FILE_HEADER_SIZE;
+    dlist->max_size = new_max_size;
+    return 0;
+}
+
+int _emi_dlist_hugeResize(Dlist *dlist, size_t new_bytes) {
+    /* puts the data in an anonymous mapping of new_bytes, or resizes the one
+    it's already in. mremap only moves the page tables around, so nothing
+    has to be copied, and the huge pages mean there are a lot fewer of them.
+    0 is returned in case of success, 1 in case of failure */
+    size_t old_bytes = (size_t) dlist->max_size * dlist->data_size;
+    char *new_location;
+
+    if(!dlist->huge) {
+        new_location = (char*) mmap(NULL, new_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if(new_location == MAP_FAILED) return 1;
+        if(dlist->size > 0) memcpy(new_location, dlist->data, (size_t) dlist->size * dlist->data_size);
+        if(dlist->data != dlist->inline_data) _common_free(dlist->allocator, dlist->data, old_bytes);
+        dlist->huge = true;
+    } else {
+#ifdef MREMAP_MAYMOVE
+        new_location = (char*) mremap(dlist->data, old_bytes, new_bytes, MREMAP_MAYMOVE);
+        if(new_location == MAP_FAILED) return 1;
+#else
+        new_location = (char*) mmap(NULL, new_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if(new_location == MAP_FAILED) return 1;
+        memcpy(new_location, dlist->data, (size_t) dlist->size * dlist->data_size);
+        munmap(dlist->data, old_bytes);
+#endif
+    }
+#ifdef MADV_HUGEPAGE
+    madvise(new_location, new_bytes, MADV_HUGEPAGE); /* only advice, so it doesn't matter if it fails */
+#endif
+
+    dlist->data = new_location;
+    return 0;
+}
+
+int _emi_dlist_setCapacity(Dlist *dlist, ptrdiff_t new_max_size) {
+    /* the one place where the data gets resized, so it doesn't matter to
+    the rest where the memory comes from.
+    0 is returned in case of success, 1 in case of failure */
+    size_t new_bytes;
+    if(_common_checkedBytes(new_max_size, dlist->data_size, &new_bytes) == 1) {
+        printf("%td elements of %d bytes is too much for a dlist\n", new_max_size, dlist->data_size);
+        return 1;
+    }
+    ptrdiff_t old_max_size = dlist->max_size;
+    if(dlist->fd != -1) {
+        if(_emi_dlist_remap(dlist, new_max_size) == 1) return 1;
+        STATS_RESIZE(dlist, old_max_size);
+        return 0;
+    }
+    if(dlist->shared != NULL && !_emi_dlist_takeShared(dlist)) {
+        /* it needs a copy anyway, so that might as well have the new size */
+        if(_emi_dlist_unshare(dlist, new_max_size) == 1) return 1;
+        STATS_RESIZE(dlist, old_max_size);
+        return 0;
+    }
+    if(dlist->huge || (dlist->huge_threshold > 0 && new_bytes >= dlist->huge_threshold)) {
+        if(_emi_dlist_hugeResize(dlist, new_bytes) == 1) return 1;
+        dlist->max_size = new_max_size;
+        STATS_RESIZE(dlist, old_max_size);
+        return 0;
+    }
+    size_t old_bytes = (size_t) old_max_size * dlist->data_size;
+    bool is_inline = dlist->data == dlist->inline_data;
+
+    /* small enough data lives in the struct itself, and goes back there
+    when it shrinks enough. Anything bigger goes through the allocator */
+    char *new_location;
+    if(new_bytes <= (size_t) dlist->inline_bytes) {
+        new_location = dlist->inline_data;
+        if(!is_inline) {
+            memcpy(new_location, dlist->data, (size_t) dlist->size * dlist->data_size);
+            _common_free(dlist->allocator, dlist->data, old_bytes);
+        }
+    } else if(is_inline) {
+        new_location = (char*) _common_alloc(dlist->allocator, new_bytes);
+        if(new_location == NULL) return 1;
+        memcpy(new_location, dlist->data, (size_t) dlist->size * dlist->data_size);
+    } else {
+        new_location = (char*) _common_realloc(dlist->allocator, dlist->data, old_bytes, new_bytes);
+        if(new_location == NULL) return 1;
+    }
+    dlist->data = new_location;
+    dlist->max_size = new_max_size;
+    STATS_RESIZE(dlist, old_max_size);
+    return 0;
+}
+
+void _emi_dlist_freeData(Dlist *dlist) {
+    /* a mapped file is cut back to what's actually used, and its header
+    gets the size, so it can just be opened again */
+    if(dlist->shared != NULL) {
+        _emi_dlist_release(dlist->shared);
+        return;
+    }
+    if(dlist->huge) {
+        munmap(dlist->data, (size_t) dlist->max_size * dlist->data_size);
+        return;
+    }
+    if(dlist->fd == -1) {
+        if(dlist->data != dlist->inline_data)
+            _common_free(dlist->allocator, dlist->data, (size_t) dlist->max_size * dlist->data_size);
+        return;
+    }
+
+    size_t length = FILE_HEADER_SIZE + (size_t) dlist->max_size * dlist->data_size;
+    if(!(dlist->flags & MAPPED_READONLY))
+        _emi_dlist_header(dlist)->size = dlist->size;
+    munmap(dlist->data - FILE_HEADER_SIZE, length);
+    if(!(dlist->flags & MAPPED_READONLY)
+       && ftruncate(dlist->fd, FILE_HEADER_SIZE + (size_t) dlist->size * dlist->data_size) == -1)
+        printf("couldn't make the file smaller :(\n");
+    close(dlist->fd);
+    return;
+}
+
+void _emi_dlist_free(Dlist *dlist) {
+    _emi_dlist_freeData(dlist);
+    free(dlist->stats);
+    _common_free(dlist->allocator, dlist, sizeof(Dlist) + dlist->inline_bytes);
+    return;
+}
+
+
+int _emi_dlist_own(Dlist *dlist) {
+    /* every function that writes to the data calls this first, so a
+    dlist that shares its data gets a copy of its own before it's changed,
+    and a read only mapped one isn't written to at all.
+    0 is returned in case of success, 1 in case of failure */
+    if(dlist->flags & MAPPED_READONLY) {
+        printf("can't change a read only mapped dlist\n");
+        return 1;
+    }
+    if(dlist->shared == NULL || _emi_dlist_takeShared(dlist)) return 0;
+    if(_emi_dlist_setCapacity(dlist, dlist->max_size) == 1) {
+        printf("can't copy the shared data of a dlist :(\n");
+        return 1;
+    }
+    return 0;
+}
+
+int _emi_dlist_grow(Dlist *dlist, ptrdiff_t goal_size) {
     /* grows the dlist either by the growth exponential,
     or to be large enough to fit in the new size. If -1 is
     provided for the new size, the dlist is forced to
@@ -18,130 +273,565 @@ int _emi_dlist_grow(Dlist *dlist, int goal_size) {
         return 0;
     }
 
-    int new_max_size = dlist->max_size * dlist->growth_exponential;
-    if(new_max_size < goal_size) new_max_size = goal_size;
+    ptrdiff_t new_max_size = _common_grownSize(dlist->max_size, dlist->growth_exponential, goal_size, dlist->data_size);
 
-    char *new_location = (char*) realloc (dlist->data, new_max_size * dlist->data_size);
-    if(new_location == NULL) {
-        printf("reallocation failed. tried to give %d bytes, also, goal was %d\n", new_max_size * dlist->data_size, goal_size * dlist->data_size);
+    if(_emi_dlist_setCapacity(dlist, new_max_size) == 1) {
+        printf("reallocation failed. tried to give room for %td elements, also, goal was %td\n", new_max_size, goal_size);
         return 1;
     }
-    dlist->data = new_location;
-    dlist->max_size = new_max_size;
 
     return 0;
 }
 
-int _emi_dlist_shrink(Dlist *dlist, int goal_size) {
-    /* I never actually use this in any of the functions,
-    but it's nice to have, I guess?? */
+int _emi_dlist_shrink(Dlist *dlist, ptrdiff_t goal_size) {
+    /* shrinks the dlist to goal_size, or by the growth exponential
+    if -1 is provided, but never below its size.
+    0 is returned in case of success, 1 in case of failure */
     if(goal_size > dlist->max_size) {
         return 0;
     }
     if(goal_size == -1) {
         goal_size = dlist->max_size / dlist->growth_exponential;
     }
-    if(goal_size < emi_dlist_size(dlist)) {
-        goal_size = emi_dlist_size(dlist);
+    if(goal_size < dlist->size) {
+        goal_size = dlist->size;
     }
 
-    char *new_location = (char*) realloc (dlist->data, goal_size * dlist->data_size);
-    if(new_location == NULL) {
-        printf("reallocation failed. tried to give %d bytes, also, goal was %d\n", goal_size * dlist->data_size, goal_size * dlist->data_size);
+    if(_emi_dlist_setCapacity(dlist, goal_size) == 1) {
+        printf("reallocation failed. tried to give room for %td elements\n", goal_size);
         return 1;
     }
-    dlist->data = new_location;
-    dlist->max_size = goal_size;
 
     return 0;
 }
 
+void _emi_dlist_autoShrink(Dlist *dlist) {
+    /* called after anything that makes the dlist smaller. It only shrinks
+    once the size is below max_size / growth², and then to size * growth,
+    so it needs to grow by the growth exponential before it grows again
+    and shrink by it twice before it shrinks again. That way a dlist
+    that goes up and down a bit doesn't keep reallocating */
+    if(!dlist->auto_shrink || (dlist->flags & MAPPED_READONLY)) return;
+    float growth = dlist->growth_exponential;
+    if(dlist->max_size <= DEFAULT_INITIAL_SIZE || dlist->size >= dlist->max_size / (growth * growth)) return;
+
+    ptrdiff_t goal_size = dlist->size * growth;
+    if(goal_size < DEFAULT_INITIAL_SIZE) goal_size = DEFAULT_INITIAL_SIZE;
+    _emi_dlist_shrink(dlist, goal_size);
+    return;
+}
+
 
 
 
 
 
 
-/*--------------- CREATION FUNCTIONS ---------------*/
-Dlist *emi_dlist_create(int data_size, int data_type) {
-    return emi_dlist_createWithParas(data_size, data_type, DEFAULT_INITIAL_SIZE, DEFAULT_GROWTH_EXPONENTIAL);
+typedef struct {
+    /* an open addressing hash set of elements of a dlist. It only
+    stores the indices, the elements themselves stay in the dlist.
+    Taken slots are marked by storing -index-2, so they still 
+    remember which element they are */
+    ptrdiff_t *slots; /* -1 if empty */
+    ptrdiff_t  mask;
+    char      *data;
+    ptrdiff_t  stride; /* bytes between the elements, which don't have to be in a dlist */
+    int        data_size;
+} _EmiDlistIndexSet;
+
+int _emi_dlist_indexSetInit(_EmiDlistIndexSet *set, char *data, ptrdiff_t stride, int data_size, ptrdiff_t element_count) {
+    /* 0 is returned in case of success, 1 in case of failure */
+    ptrdiff_t capacity = 16;
+    while(capacity < 2 * (ptrdiff_t) element_count) capacity *= 2; /* at most half full */
+
+    set->slots = (ptrdiff_t*) malloc (capacity * sizeof(ptrdiff_t));
+    if(set->slots == NULL) {
+        printf("malloc failed in _emi_dlist_indexSetInit :(\n");
+        return 1;
+    }
+    memset(set->slots, 0xff, capacity * sizeof(ptrdiff_t)); /* all -1 */
+    set->mask      = capacity - 1;
+    set->data      = data;
+    set->stride    = stride;
+    set->data_size = data_size;
+    return 0;
+}
+
+ptrdiff_t *_emi_dlist_indexSetFind(_EmiDlistIndexSet *set, void *element) {
+    /* returns the slot that has an equal element in it, or the empty
+    slot where it should go */
+    ptrdiff_t position = _common_hashBytes(element, set->data_size) & set->mask;
+    while(true) {
+        ptrdiff_t *slot = &set->slots[position];
+        if(*slot == -1)
+            return slot;
+        ptrdiff_t index = *slot >= 0 ? *slot : -*slot - 2;
+        if(memcmp(set->data + index * set->stride, element, set->data_size) == 0)
+            return slot;
+        position = (position + 1) & set->mask;
+    }
+}
+
+void _emi_dlist_indexSetFree(_EmiDlistIndexSet *set) {
+    free(set->slots);
 }
 
 
-Dlist *emi_dlist_createWithParas(int data_size, int data_type, int initial_size, float growth_exponential) {
-    Dlist *new_dlist = (Dlist*) malloc (sizeof(Dlist));
-    char *data = (char*) malloc (initial_size * data_size);
+
+
+
+
+
+Dlist *_emi_dlist_create(int data_size, int data_type, ptrdiff_t initial_size, float growth_exponential, size_t huge_threshold, EmiAllocator *allocator) {
+    /* what all the create functions come down to. If it's already too big
+    for its huge threshold at the start, it starts out empty and gets its
+    real size through setCapacity, so it never gets malloc'd first. If it's
+    at most SMALL_BUFFER_BYTES, the data is put right after the struct, so
+    it's one allocation instead of two */
+    size_t bytes;
+    if(_common_checkedBytes(initial_size, data_size, &bytes) == 1) {
+        printf("can't make a dlist with room for %td elements of %d bytes\n", initial_size, data_size);
+        return NULL;
+    }
+    bool starts_huge = huge_threshold > 0 && bytes >= huge_threshold;
+    size_t inline_bytes = !starts_huge && bytes <= SMALL_BUFFER_BYTES ? bytes : 0;
+    bool needs_data = !starts_huge && inline_bytes == 0 && bytes > 0;
+
+    Dlist *new_dlist = (Dlist*) _common_alloc(allocator, sizeof(Dlist) + inline_bytes);
+    char *data = needs_data && new_dlist != NULL ? (char*) _common_alloc(allocator, bytes) : NULL;
+    if(new_dlist == NULL || (needs_data && data == NULL)) {
+        printf("malloc failed in emi_dlist_create :(\n");
+        if(new_dlist != NULL) _common_free(allocator, new_dlist, sizeof(Dlist) + inline_bytes);
+        return NULL;
+    }
 
     new_dlist->data_size          = data_size;
     new_dlist->data_type          = data_type;
     new_dlist->size               = 0;
-    new_dlist->max_size           = initial_size;
+    new_dlist->max_size           = starts_huge ? 0 : initial_size;
     new_dlist->growth_exponential = growth_exponential;
-    new_dlist->data               = data;
+    new_dlist->auto_shrink        = false;
+    new_dlist->data               = starts_huge || needs_data ? data : new_dlist->inline_data;
+    new_dlist->inline_bytes       = (int) inline_bytes;
+    new_dlist->fd                 = -1;
+    new_dlist->flags              = 0;
+    new_dlist->huge_threshold     = huge_threshold;
+    new_dlist->huge               = false;
+    new_dlist->allocator          = allocator;
+    new_dlist->copy_on_write      = false;
+    new_dlist->shared             = NULL;
+    new_dlist->stats              = _common_statsCreate();
+    STATS_RESIZE(new_dlist, new_dlist->max_size);
+
+    if(starts_huge && _emi_dlist_setCapacity(new_dlist, initial_size) == 1) {
+        printf("couldn't make room for %td elements in emi_dlist_createHuge :(\n", initial_size);
+        _emi_dlist_free(new_dlist);
+        return NULL;
+    }
+    return new_dlist;
+}
+
+
+
+
 
+
+bool _emi_dlist_canShare(Dlist *original) {
+    /* inline data goes away with the struct, and mapped and huge data
+    can't go through the allocator, so those always get copied */
+    return original->copy_on_write
+        && original->fd == -1
+        && !original->huge
+        && original->data != original->inline_data;
+}
+
+Dlist *_emi_dlist_createShared(Dlist *original, ptrdiff_t start_index, ptrdiff_t size, ptrdiff_t max_size) {
+    /* a dlist of size elements of the data of original, from start_index
+    on, without copying them. The first time, the data of original
+    becomes shared data, which original has the first reference to */
+    if(original->shared == NULL) {
+        /* it comes from the dlist's allocator too, so an arena gets it back */
+        _EmiDlistShared *shared = (_EmiDlistShared*) _common_alloc(original->allocator, sizeof(_EmiDlistShared));
+        if(shared == NULL) {
+            printf("malloc failed in emi_dlist_createCopy :(\n");
+            return NULL;
+        }
+        shared->refs      = 1;
+        shared->data      = original->data;
+        shared->bytes     = (size_t) original->max_size * original->data_size;
+        shared->allocator = original->allocator;
+        original->shared  = shared;
+    }
+
+    Dlist *new_dlist = _emi_dlist_create(original->data_size, original->data_type, 0, original->growth_exponential, original->huge_threshold, original->allocator);
+    if(new_dlist == NULL) return NULL;
+    __atomic_add_fetch(&original->shared->refs, 1, __ATOMIC_RELAXED);
+    new_dlist->shared        = original->shared;
+    new_dlist->data          = original->data + start_index * original->data_size;
+    new_dlist->size          = size;
+    new_dlist->max_size      = max_size;
+    new_dlist->copy_on_write = true;
+    STATS_RESIZE(new_dlist, 0);
     return new_dlist;
 }
 
+DlistView _emi_dlist_asView(Dlist *dlist) {
+    DlistView view = { dlist->data, dlist->size, dlist->data_size, dlist->data_size, dlist->data_type };
+    return view;
+}
+
+bool _emi_dlist_viewIsContiguous(DlistView *view) {
+    /* then the SIMD searches and plain memcpys can be used on it */
+    return view->stride == view->data_size;
+}
+
+void _emi_dlist_appendView(Dlist *dlist, DlistView view) {
+    if(_emi_dlist_grow(dlist, dlist->size + view.size) == 1 || _emi_dlist_own(dlist) == 1) {
+        printf("can't extend :(\n");
+        return;
+    }
+    char *destination = dlist->data + dlist->size * dlist->data_size; /* readRaw would fail on an empty dlist */
+    if(_emi_dlist_viewIsContiguous(&view)) {
+        memcpy(destination, view.data, (size_t) view.size * view.data_size);
+    } else {
+        char *source = view.data;
+        for(ptrdiff_t i=0; i<view.size; i++) {
+            memcpy(destination, source, view.data_size);
+            destination += view.data_size;
+            source      += view.stride;
+        }
+    }
+    dlist->size += view.size;
+    return;
+}
+
+
+
+
+/*--------------- CREATION FUNCTIONS ---------------*/
+Dlist *emi_dlist_create(int data_size, int data_type) {
+    STATS_CALL_GLOBAL(create);
+    return _emi_dlist_create(data_size, data_type, DEFAULT_INITIAL_SIZE, DEFAULT_GROWTH_EXPONENTIAL, 0, NULL);
+}
+
+
+Dlist *emi_dlist_createWithParas(int data_size, int data_type, ptrdiff_t initial_size, float growth_exponential) {
+    STATS_CALL_GLOBAL(createWithParas);
+    return _emi_dlist_create(data_size, data_type, initial_size, growth_exponential, 0, NULL);
+}
+
+
+Dlist *emi_dlist_createWithAllocator(int data_size, int data_type, ptrdiff_t initial_size, float growth_exponential, EmiAllocator *allocator) {
+    STATS_CALL_GLOBAL(createWithAllocator);
+    return _emi_dlist_create(data_size, data_type, initial_size, growth_exponential, 0, allocator);
+}
+
 
-Dlist *emi_dlist_createFromArray (void *data, int array_length, int data_size, int data_type) {
-    Dlist *new_dlist = emi_dlist_createWithParas(data_size, data_type, data_size*DEFAULT_GROWTH_EXPONENTIAL, DEFAULT_GROWTH_EXPONENTIAL);
-    emi_dlist_extendByArray(new_dlist, data, array_length);
+Dlist *emi_dlist_createFromArray (void *data, ptrdiff_t array_length, int data_size, int data_type) {
+    STATS_CALL_GLOBAL(createFromArray);
+    Dlist *new_dlist = _emi_dlist_create(data_size, data_type, data_size*DEFAULT_GROWTH_EXPONENTIAL, DEFAULT_GROWTH_EXPONENTIAL, 0, NULL);
+    if(new_dlist == NULL) return NULL;
+    DlistView array = { (char*) data, array_length, data_size, data_size, data_type };
+    _emi_dlist_appendView(new_dlist, array);
     return new_dlist;
 }
 
 
-Dlist *emi_dlist_createCopy(Dlist *original) {
-    Dlist *new_dlist = emi_dlist_createWithParas(original->data_size, original->data_type, original->max_size, original->growth_exponential);
+Dlist *_emi_dlist_createCopy(Dlist *original) {
+    if(_emi_dlist_canShare(original))
+        return _emi_dlist_createShared(original, 0, original->size, original->max_size);
+    Dlist *new_dlist = _emi_dlist_create(original->data_size, original->data_type, original->max_size, original->growth_exponential, original->huge_threshold, original->allocator);
+    if(new_dlist == NULL) return NULL;
     new_dlist->size = original->size;
-    memcpy(new_dlist->data, original->data, original->size * original->data_size);
+    memcpy(new_dlist->data, original->data, (size_t) original->size * original->data_size);
     return new_dlist;
 }
 
-Dlist *emi_dlist_createSublist(Dlist *original, int start_index, int end_index) {
+Dlist *emi_dlist_createCopy(Dlist *original) {
+    STATS_CALL(original, createCopy);
+    return _emi_dlist_createCopy(original);
+}
+
+Dlist *_emi_dlist_createSublist(Dlist *original, ptrdiff_t start_index, ptrdiff_t end_index) {
     _common_fixIndexInclusive(original->size, &start_index);
     _common_fixIndexInclusive(original->size, &end_index);
 
-    int new_dlist_size = end_index - start_index;
+    ptrdiff_t new_dlist_size = end_index - start_index;
 
     if(new_dlist_size < 0)
         return NULL;
 
-    Dlist *new_dlist = emi_dlist_createWithParas(original->data_size, original->data_type, new_dlist_size, original->growth_exponential);
-    new_dlist->data = (char*) malloc (original->max_size * original->data_size);
+    if(_emi_dlist_canShare(original))
+        return _emi_dlist_createShared(original, start_index, new_dlist_size, new_dlist_size);
+
+    Dlist *new_dlist = _emi_dlist_create(original->data_size, original->data_type, new_dlist_size, original->growth_exponential, original->huge_threshold, original->allocator);
+    if(new_dlist == NULL) return NULL;
     new_dlist->size = new_dlist_size;
 
-    char* data_start = emi_dlist_readRaw(original, start_index);
+    /* not readRaw, the range can be empty */
+    char* data_start = original->data + start_index * original->data_size;
 
-    memcpy(new_dlist->data, data_start, new_dlist_size * original->data_size);
+    memcpy(new_dlist->data, data_start, (size_t) new_dlist_size * original->data_size);
     return new_dlist;
 }
 
-Dlist *emi_dlist_createSplit(Dlist *original, int index) {
+Dlist *emi_dlist_createSublist(Dlist *original, ptrdiff_t start_index, ptrdiff_t end_index) {
+    STATS_CALL(original, createSublist);
+    return _emi_dlist_createSublist(original, start_index, end_index);
+}
+
+Dlist *_emi_dlist_createFromView(DlistView view) {
+    Dlist *new_dlist = _emi_dlist_create(view.data_size, view.data_type, view.size > 0 ? view.size : DEFAULT_INITIAL_SIZE, DEFAULT_GROWTH_EXPONENTIAL, 0, NULL);
+    if(new_dlist == NULL) return NULL;
+    _emi_dlist_appendView(new_dlist, view);
+    return new_dlist;
+}
+
+Dlist *emi_dlist_createFromView(DlistView view) {
+    STATS_CALL_GLOBAL(createFromView);
+    return _emi_dlist_createFromView(view);
+}
+
+Dlist *emi_dlist_createHuge(int data_size, int data_type, ptrdiff_t initial_size, float growth_exponential, size_t huge_threshold) {
+    STATS_CALL_GLOBAL(createHuge);
+    return _emi_dlist_create(data_size, data_type, initial_size, growth_exponential, huge_threshold, NULL);
+}
+
+Dlist *emi_dlist_createSplit(Dlist *original, ptrdiff_t index) {
+    STATS_CALL(original, createSplit);
     _common_fixIndex(original->size+1, &index);
-    Dlist* output = emi_dlist_createSublist(original, index, -1);
+    Dlist* output = _emi_dlist_createSublist(original, index, -1);
     original->size = index;
     return output;
 }
 
+void emi_dlist_setCopyOnWrite(Dlist *dlist, bool copy_on_write) {
+    /* turning it off only means new copies are real copies again, the
+    ones that share the data already keep doing that until they're changed */
+    STATS_CALL(dlist, setCopyOnWrite);
+    dlist->copy_on_write = copy_on_write;
+    return;
+}
+
+
+
+
+
+/*--------------- MAPPED FUNCTIONS ---------------*/
+Dlist *emi_dlist_openMapped(char *path, int data_size, int data_type, int flags) {
+    /* opens the file at path as a dlist. An empty file (or a new one, with
+    MAPPED_CREATE) becomes an empty dlist. Otherwise the header has to
+    say it has elements of data_size and data_type */
+    STATS_CALL_GLOBAL(openMapped);
+    if(data_size <= 0) {
+        printf("can't open a dlist with elements of %d bytes\n", data_size);
+        return NULL;
+    }
+    bool read_only = flags & MAPPED_READONLY;
+    int open_flags = read_only ? O_RDONLY : O_RDWR;
+    if(!read_only && (flags & MAPPED_CREATE))   open_flags |= O_CREAT;
+    if(!read_only && (flags & MAPPED_TRUNCATE)) open_flags |= O_TRUNC;
+
+    int fd = open(path, open_flags, 0644);
+    if(fd == -1) {
+        printf("couldn't open %s\n", path);
+        return NULL;
+    }
+    struct stat status;
+    if(fstat(fd, &status) == -1) {
+        printf("couldn't look at %s\n", path);
+        close(fd);
+        return NULL;
+    }
+
+    bool fresh = status.st_size == 0 && !read_only;
+    long long max_size = fresh ? DEFAULT_INITIAL_SIZE : ((long long) status.st_size - FILE_HEADER_SIZE) / data_size;
+    if(max_size < 0 || max_size > PTRDIFF_MAX / data_size) {
+        printf("%s doesn't fit in a dlist\n", path);
+        close(fd);
+        return NULL;
+    }
+    size_t length = FILE_HEADER_SIZE + (size_t) max_size * data_size;
+    if(fresh && ftruncate(fd, length) == -1) {
+        printf("couldn't make %s bigger :(\n", path);
+        close(fd);
+        return NULL;
+    }
+
+    char *mapping = (char*) mmap(NULL, length, read_only ? PROT_READ : PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if(mapping == MAP_FAILED) {
+        printf("couldn't map %s :(\n", path);
+        close(fd);
+        return NULL;
+    }
+    _CommonFileHeader *header = (_CommonFileHeader*) mapping;
+    if(fresh) {
+        _common_fileHeaderInit(header, data_size, data_type, 0, DEFAULT_GROWTH_EXPONENTIAL);
+    } else if(_common_fileHeaderCheck(header, data_size, data_type) == 1 || header->size > max_size) {
+        printf("can't open %s as a dlist\n", path);
+        munmap(mapping, length);
+        close(fd);
+        return NULL;
+    }
+
+    Dlist *new_dlist = (Dlist*) malloc (sizeof(Dlist));
+    if(new_dlist == NULL) {
+        printf("malloc failed in emi_dlist_openMapped :(\n");
+        munmap(mapping, length);
+        close(fd);
+        return NULL;
+    }
+    new_dlist->data_size          = data_size;
+    new_dlist->data_type          = data_type;
+    new_dlist->size               = header->size;
+    new_dlist->max_size           = max_size;
+    new_dlist->growth_exponential = header->growth_exponential;
+    new_dlist->auto_shrink        = false;
+    new_dlist->data               = mapping + FILE_HEADER_SIZE;
+    new_dlist->inline_bytes       = 0;
+    new_dlist->fd                 = fd;
+    new_dlist->flags              = flags;
+    new_dlist->huge_threshold     = 0;
+    new_dlist->huge               = false;
+    new_dlist->allocator          = NULL;
+    new_dlist->copy_on_write      = false;
+    new_dlist->shared             = NULL;
+    new_dlist->stats              = _common_statsCreate();
+    STATS_RESIZE(new_dlist, max_size);
+
+    return new_dlist;
+}
+
+
+int _emi_dlist_sync(Dlist *dlist) {
+    /* 0 is returned in case of success, 1 in case of failure */
+    if(dlist->fd == -1) {
+        printf("only mapped dlists can be synced\n");
+        return 1;
+    }
+    if(dlist->flags & MAPPED_READONLY) return 0;
+
+    _emi_dlist_header(dlist)->size = dlist->size;
+    if(msync(dlist->data - FILE_HEADER_SIZE, FILE_HEADER_SIZE + (size_t) dlist->size * dlist->data_size, MS_SYNC) == -1) {
+        printf("couldn't sync :(\n");
+        return 1;
+    }
+    return 0;
+}
+
+int emi_dlist_sync(Dlist *dlist) {
+    STATS_CALL(dlist, sync);
+    return _emi_dlist_sync(dlist);
+}
+
+
+void emi_dlist_close(Dlist *dlist) {
+    STATS_CALL(dlist, close);
+    if(dlist->fd != -1) _emi_dlist_sync(dlist);
+    _emi_dlist_free(dlist);
+    return;
+}
+
+
+
+
+
+/*--------------- SAVING FUNCTIONS ---------------*/
+int emi_dlist_save(Dlist *dlist, FILE *file) {
+    /* 0 is returned in case of success, 1 in case of failure */
+    STATS_CALL(dlist, save);
+    return _common_save(file, dlist->data, dlist->size, dlist->data_size, dlist->data_type, dlist->growth_exponential);
+}
+
+
+int _emi_dlist_loadGrow(void *dlist, ptrdiff_t goal_size) {
+    /* how _common_loadData makes room in a dlist */
+    return _emi_dlist_grow((Dlist*) dlist, goal_size) == 1 || _emi_dlist_own((Dlist*) dlist) == 1;
+}
+
+int _emi_dlist_loadData(Dlist *dlist, FILE *file, ptrdiff_t size, ptrdiff_t chunk_size) {
+    /* the part of loadChunked after the header, which load uses as well.
+    0 is returned in case of success, 1 in case of failure */
+    return _common_loadData(file, size, chunk_size, dlist->data_size, &dlist->data, &dlist->size, dlist, _emi_dlist_loadGrow);
+}
+
+Dlist *emi_dlist_load(FILE *file) {
+    STATS_CALL_GLOBAL(load);
+    _CommonFileHeader header;
+    if(_common_loadHeader(file, &header, -1, -1) == 1) return NULL;
+
+    /* the size in the header isn't trusted with an allocation, the
+    dlist only grows as the elements actually get read */
+    ptrdiff_t initial_size = header.size < LOAD_CHUNK_SIZE ? header.size : LOAD_CHUNK_SIZE;
+    Dlist *new_dlist = _emi_dlist_create(header.data_size, header.data_type, initial_size > 0 ? initial_size : DEFAULT_INITIAL_SIZE, header.growth_exponential, 0, NULL);
+    if(new_dlist == NULL) {
+        printf("malloc failed in emi_dlist_load :(\n");
+        return NULL;
+    }
+    if(_emi_dlist_loadData(new_dlist, file, header.size, LOAD_CHUNK_SIZE) == 1) {
+        _emi_dlist_free(new_dlist);
+        return NULL;
+    }
+    return new_dlist;
+}
+
+
+int emi_dlist_loadChunked(Dlist *dlist, FILE *file, ptrdiff_t chunk_size) {
+    /* appends what's in the file to the dlist, reading straight into it,
+    chunk_size elements at a time. So there's never a buffer for the
+    whole file, and the dlist only grows as the data actually arrives.
+    If the file ends too early, what was read is kept.
+    0 is returned in case of success, 1 in case of failure */
+    STATS_CALL(dlist, loadChunked);
+    _CommonFileHeader header;
+    if(_common_loadHeader(file, &header, dlist->data_size, dlist->data_type) == 1) return 1;
+    if(chunk_size <= 0) chunk_size = LOAD_CHUNK_SIZE;
+    return _emi_dlist_loadData(dlist, file, header.size, chunk_size);
+}
+
+
 
 /*--------------- READING FUNCTIONS ---------------*/
-void *emi_dlist_read(Dlist *dlist, int index) {
-    if(emi_dlist_size(dlist) == 0) {
+/* the internal versions of public functions that other functions use
+aren't counted in the stats, so only the calls that were made are */
+int _emi_dlist_readInto(Dlist *dlist, ptrdiff_t index, void *output) {
+    if(dlist->size == 0) {
         printf("can't read from empty dlist\n");
-        return NULL;
+        return 1;
     }
+    _common_fixIndex(dlist->size, &index);
+    memcpy(output, dlist->data + index * dlist->data_size, dlist->data_size);
+    return 0;
+}
+
+void *emi_dlist_read(Dlist *dlist, ptrdiff_t index) {
+    STATS_CALL(dlist, read);
     char *output = (char *) malloc (dlist->data_size);
-    /* index handling is done inside readRaw */
-    memcpy(output, emi_dlist_readRaw(dlist, index), dlist->data_size);
+    if(output == NULL) {
+        printf("malloc failed in emi_dlist_read :(\n");
+        return NULL;
+    }
+    if(_emi_dlist_readInto(dlist, index, output) == 1) {
+        free(output);
+        return NULL;
+    }
     return output;
 }
 
-void *emi_dlist_readRaw(Dlist *dlist, int index) {
-    if(emi_dlist_size(dlist) == 0) {
+int emi_dlist_readInto(Dlist *dlist, ptrdiff_t index, void *output) {
+    /* copies the element into output, which has to be at least data_size large.
+    0 is returned in case of success, 1 in case of failure */
+    STATS_CALL(dlist, readInto);
+    return _emi_dlist_readInto(dlist, index, output);
+}
+
+void *emi_dlist_readRaw(Dlist *dlist, ptrdiff_t index) {
+    STATS_CALL(dlist, readRaw);
+    if(dlist->size == 0) {
         printf("can't read from empty dlist\n");
         return NULL;
     }
-    _common_fixIndex(emi_dlist_size(dlist), &index);
+    _common_fixIndex(dlist->size, &index);
     return dlist->data + index * dlist->data_size;
 }
 
@@ -149,105 +839,147 @@ void *emi_dlist_readRaw(Dlist *dlist, int index) {
 
 
 /*--------------- MODIFICATION FUNCTIONS ---------------*/
-void emi_dlist_append(Dlist *dlist, void *data) {
-    if(_emi_dlist_grow(dlist, emi_dlist_size(dlist) + 1) == 1) {
+void _emi_dlist_append(Dlist *dlist, void *data) {
+    if(_emi_dlist_grow(dlist, dlist->size + 1) == 1 || _emi_dlist_own(dlist) == 1) {
         printf("can't append :(\n");
         return;
     }
-    void *new_item;
-    if(emi_dlist_size(dlist) == 0) {
-        new_item = dlist->data;
-    } else {
-        new_item = emi_dlist_readRaw(dlist, -1) + dlist->data_size;
-    }
-    memcpy(new_item, data, dlist->data_size);
-    (dlist->size)++;
+    memcpy(dlist->data + dlist->size * dlist->data_size, data, dlist->data_size);
+    dlist->size++;
     return;
 }
 
-void emi_dlist_prepend(Dlist *dlist, void *data) {
-    emi_dlist_insert(dlist, data, 0);
-}
-
-void emi_dlist_insert(Dlist *dlist, void *data, int index) {
-    if(_emi_dlist_grow(dlist, emi_dlist_size(dlist) + 1) == 1) {
-        printf("can't append :(\n");
+void _emi_dlist_insertRange(Dlist *dlist, void *data, ptrdiff_t count, ptrdiff_t index) {
+    /* inserts count elements from data, so that the first one ends up
+    at index. Everything after it is moved in one go */
+    if(count <= 0) return;
+    if(_emi_dlist_grow(dlist, dlist->size + count) == 1 || _emi_dlist_own(dlist) == 1) {
+        printf("can't insert :(\n");
         return;
     }
-    _common_fixIndexInclusive((emi_dlist_size(dlist)) + 1, &index);
-
-    char *next_item;
-    if(index == -1) { /* if it is an empty list, just put it as the first element */
-        next_item = dlist->data;
-    } else {
-        next_item = emi_dlist_readRaw(dlist, -1) + dlist->data_size;
+    _common_fixIndexInclusive(dlist->size + 1, &index);
+    if(index > dlist->size) { /* past the end just means appending */
+        index = dlist->size;
     }
 
-    for(int i=emi_dlist_size(dlist); i>index; i--) {
-        memcpy(next_item, next_item - dlist->data_size, dlist->data_size);
-        next_item -= dlist->data_size;
-    }
+    char *position = dlist->data + index * dlist->data_size;
+    memmove(position + count * dlist->data_size, position, (dlist->size - index) * dlist->data_size);
+    STATS_MOVED(dlist, (dlist->size - index) * dlist->data_size);
+    memcpy(position, data, count * dlist->data_size);
+    dlist->size += count;
+    return;
+}
+
+void emi_dlist_append(Dlist *dlist, void *data) {
+    STATS_CALL(dlist, append);
+    _emi_dlist_append(dlist, data);
+    return;
+}
+
+void emi_dlist_prepend(Dlist *dlist, void *data) {
+    STATS_CALL(dlist, prepend);
+    _emi_dlist_insertRange(dlist, data, 1, 0);
+}
 
-    memcpy(next_item, data, dlist->data_size);
-    (dlist->size)++;
+void emi_dlist_insert(Dlist *dlist, void *data, ptrdiff_t index) {
+    STATS_CALL(dlist, insert);
+    _emi_dlist_insertRange(dlist, data, 1, index);
     return;
 }
 
+void emi_dlist_insertRange(Dlist *dlist, void *data, ptrdiff_t count, ptrdiff_t index) {
+    STATS_CALL(dlist, insertRange);
+    _emi_dlist_insertRange(dlist, data, count, index);
+    return;
+}
 
 
-void emi_dlist_remove(Dlist *dlist, int index) {
-    if(emi_dlist_size(dlist) == 0) {
+
+void emi_dlist_remove(Dlist *dlist, ptrdiff_t index) {
+    STATS_CALL(dlist, remove);
+    if(dlist->size == 0) {
         printf("can't remove from empty dlist\n");
         return;
     }
-    _common_fixIndex(emi_dlist_size(dlist), &index);
+    if(_emi_dlist_own(dlist) == 1) return;
+    _common_fixIndex(dlist->size, &index);
 
-    char* current_item = emi_dlist_readRaw(dlist, index);    
-    for(int i=index; i<(emi_dlist_size(dlist))-1; i++) {
-        memcpy(current_item, current_item+dlist->data_size, dlist->data_size);
-        current_item += dlist->data_size;
-    }
+    char *position = dlist->data + index * dlist->data_size;
+    memmove(position, position + dlist->data_size, (dlist->size - index - 1) * dlist->data_size);
+    STATS_MOVED(dlist, (dlist->size - index - 1) * dlist->data_size);
     dlist->size -= 1;
+    _emi_dlist_autoShrink(dlist);
     return;
 }
 
-void *emi_dlist_pop(Dlist *dlist) {
-    if(emi_dlist_size(dlist) == 0) {
+void emi_dlist_removeRange(Dlist *dlist, ptrdiff_t start_index, ptrdiff_t end_index) {
+    /* removes the elements from start_index up to (not including) end_index,
+    the indices work the same as in emi_dlist_createSublist */
+    STATS_CALL(dlist, removeRange);
+    _common_fixIndexInclusive(dlist->size, &start_index);
+    _common_fixIndexInclusive(dlist->size, &end_index);
+
+    ptrdiff_t count = end_index - start_index;
+    if(count <= 0 || _emi_dlist_own(dlist) == 1) return;
+
+    char *position = dlist->data + start_index * dlist->data_size;
+    memmove(position, position + count * dlist->data_size, (dlist->size - end_index) * dlist->data_size);
+    STATS_MOVED(dlist, (dlist->size - end_index) * dlist->data_size);
+    dlist->size -= count;
+    _emi_dlist_autoShrink(dlist);
+    return;
+}
+
+int _emi_dlist_popInto(Dlist *dlist, void *output) {
+    if(dlist->size == 0) {
         printf("can't pop from empty dlist\n");
-        return NULL;
+        return 1;
     }
+    memcpy(output, dlist->data + (dlist->size - 1) * dlist->data_size, dlist->data_size);
+    dlist->size -= 1;
+    _emi_dlist_autoShrink(dlist);
+    return 0;
+}
+
+int emi_dlist_popInto(Dlist *dlist, void *output) {
+    /* 0 is returned in case of success, 1 in case of failure */
+    STATS_CALL(dlist, popInto);
+    return _emi_dlist_popInto(dlist, output);
+}
+
+void *emi_dlist_pop(Dlist *dlist) {
+    STATS_CALL(dlist, pop);
     char *output = (char *) malloc (dlist->data_size);
     if(output == NULL) {
         printf("malloc failed in emi_dlist_pop :(\n");
         return NULL;
     }
-    memcpy(output, emi_dlist_readRaw(dlist, emi_dlist_size(dlist) - 1), dlist->data_size);
-    dlist->size -= 1;
+    if(_emi_dlist_popInto(dlist, output) == 1) {
+        free(output);
+        return NULL;
+    }
     return output;
 }
 
 
-void emi_dlist_set(Dlist *dlist, void *data, int index) {
-    if(emi_dlist_size(dlist) == 0) {
+void emi_dlist_set(Dlist *dlist, void *data, ptrdiff_t index) {
+    STATS_CALL(dlist, set);
+    if(dlist->size == 0) {
         printf("can't set to empty dlist\n");
         return;
     }
-    _common_fixIndex(emi_dlist_size(dlist), &index);
-    memcpy(emi_dlist_readRaw(dlist, index), data, dlist->data_size);
+    if(_emi_dlist_own(dlist) == 1) return;
+    _common_fixIndex(dlist->size, &index);
+    memcpy(dlist->data + index * dlist->data_size, data, dlist->data_size);
     return;
 }
 
 
 
-void emi_dlist_swap(Dlist *dlist, int index_one, int index_two) {
-    if(emi_dlist_size(dlist) == 0) {
-        printf("can't swap in empty dlist\n");
-        return;
-    }
-    _common_fixIndex(emi_dlist_size(dlist), &index_one);
-    _common_fixIndex(emi_dlist_size(dlist), &index_two);
-    char* ptr_one = emi_dlist_readRaw(dlist, index_one);
-    char* ptr_two = emi_dlist_readRaw(dlist, index_two);
+void _emi_dlist_swap(Dlist *dlist, ptrdiff_t index_one, ptrdiff_t index_two) {
+    /* the indices have to be fixed already, and the dlist owned */
+    char* ptr_one = dlist->data + index_one * dlist->data_size;
+    char* ptr_two = dlist->data + index_two * dlist->data_size;
     char buffer[dlist->data_size];
 
     memcpy(buffer, ptr_one, dlist->data_size);
@@ -256,27 +988,40 @@ void emi_dlist_swap(Dlist *dlist, int index_one, int index_two) {
     return;
 }
 
+void emi_dlist_swap(Dlist *dlist, ptrdiff_t index_one, ptrdiff_t index_two) {
+    STATS_CALL(dlist, swap);
+    if(dlist->size == 0) {
+        printf("can't swap in empty dlist\n");
+        return;
+    }
+    if(_emi_dlist_own(dlist) == 1) return;
+    _common_fixIndex(dlist->size, &index_one);
+    _common_fixIndex(dlist->size, &index_two);
+    _emi_dlist_swap(dlist, index_one, index_two);
+    return;
+}
+
 
-void emi_dlist_extendByArray(Dlist *dlist, void *data, int array_length) {
-    if(_emi_dlist_grow(dlist, emi_dlist_size(dlist) + array_length) == 1) {
+void emi_dlist_extendByArray(Dlist *dlist, void *data, ptrdiff_t array_length) {
+    STATS_CALL(dlist, extendByArray);
+    if(_emi_dlist_grow(dlist, dlist->size + array_length) == 1 || _emi_dlist_own(dlist) == 1) {
         printf("can't extend :(\n");
         return;
     }
-    memcpy(&dlist->data[emi_dlist_size(dlist) * dlist->data_size], data, array_length * dlist->data_size);
+    memcpy(&dlist->data[dlist->size * dlist->data_size], data, array_length * dlist->data_size);
     dlist->size += array_length;
     return;
 }
 
 void emi_dlist_extendByDlist (Dlist *dlist, Dlist *data) {
-    if(_emi_dlist_grow(dlist, emi_dlist_size(dlist) + data->size) == 1) {
-        printf("can't extend :(\n");
-        return;
-    }
+    STATS_CALL(dlist, extendByDlist);
+    _emi_dlist_appendView(dlist, _emi_dlist_asView(data));
+    return;
+}
 
-    char *source = data->data;
-    char *destination = emi_dlist_readRaw(dlist, -1) + dlist->data_size;
-    memcpy(destination, source, data->size * data->data_size);
-    dlist->size += data->size;
+void emi_dlist_extendByView (Dlist *dlist, DlistView data) {
+    STATS_CALL(dlist, extendByView);
+    _emi_dlist_appendView(dlist, data);
     return;
 }
 
@@ -287,46 +1032,289 @@ void emi_dlist_extendByDlist (Dlist *dlist, Dlist *data) {
 
 // /*--------------- ORDER CHANGING FUNCTIONS ---------------*/
 void emi_dlist_randomizeOrder(Dlist *dlist) {
-    for(int i=0; i<emi_dlist_size(dlist) - 1; i++) {
-        int j = i + rand() % (emi_dlist_size(dlist) - i);
-        emi_dlist_swap(dlist, i, j);
+    STATS_CALL(dlist, randomizeOrder);
+    if(_emi_dlist_own(dlist) == 1) return;
+    /* one rand() only goes up to RAND_MAX, which can be smaller than the
+    dlist, so it only seeds a counter that _common_mix64 turns into 64 random bits */
+    uint64_t state = (uint64_t) rand() << 32 ^ (uint64_t) rand();
+    for(ptrdiff_t i=0; i<dlist->size - 1; i++) {
+        uint64_t range = dlist->size - i;
+        uint64_t random;
+        do {
+            state += 0x9e3779b97f4a7c15ULL;
+            random = _common_mix64(state);
+        } while(random < -range % range); /* the numbers below 2^64 % range would make small j more likely */
+        _emi_dlist_swap(dlist, i, i + (ptrdiff_t) (random % range));
     }
     return;
 }
 
 
 
-void emi_dlist_bubbleSort(Dlist *dlist) {
-    for(int i=emi_dlist_size(dlist) - 1; i>0; i--) {
-        char *current_item = dlist->data;
-        for(int j=0; j<i; j++) {
-            if(_common_defaultOrder(dlist->data_type, current_item, current_item + dlist->data_size) == -1) {
-                emi_dlist_swap(dlist, j, j+1);
+bool _emi_dlist_useRadixSort(Dlist *dlist) {
+    /* the default order only knows ints, and for those the radix 
+    sort gives the same result as the stable sort, but in O(n) */
+    return dlist->data_type == DATA_TYPE_INT
+        && dlist->size >= RADIX_SORT_THRESHOLD
+        && dlist->data_size % sizeof(int) == 0;
+}
+
+void _emi_dlist_betterSortByOrder(Dlist *dlist, int(*order)(void*, void*)) {
+    if(_emi_dlist_own(dlist) == 1) return;
+    if(_common_sort(dlist->data, dlist->size, dlist->data_size, order) == 1)
+        printf("can't sort :(\n");
+    return;
+}
+
+void _emi_dlist_stableSortByOrder(Dlist *dlist, int(*order)(void*, void*)) {
+    if(_emi_dlist_own(dlist) == 1) return;
+    if(_common_stableSort(dlist->data, dlist->size, dlist->data_size, order) == 1)
+        printf("can't sort :(\n");
+    return;
+}
+
+void _emi_dlist_radixSort(Dlist *dlist) {
+    if(_emi_dlist_own(dlist) == 1) return;
+    switch(dlist->data_type) {
+    case DATA_TYPE_CHAR:
+    case DATA_TYPE_INT:
+    case DATA_TYPE_FLOAT:
+        if(_common_radixSort(dlist->data, dlist->size, dlist->data_size, dlist->data_type) == 1)
+            printf("can't sort :(\n");
+        break;
+    default:
+        _emi_dlist_stableSortByOrder(dlist, _common_orderFunction(dlist->data_type));
+    }
+    return;
+}
+
+void _emi_dlist_stableSort(Dlist *dlist) {
+    if(_emi_dlist_useRadixSort(dlist)) {
+        _emi_dlist_radixSort(dlist);
+        return;
+    }
+    _emi_dlist_stableSortByOrder(dlist, _common_orderFunction(dlist->data_type));
+    return;
+}
+
+void emi_dlist_betterSort(Dlist *dlist) {
+    STATS_CALL(dlist, betterSort);
+    if(_emi_dlist_useRadixSort(dlist)) {
+        _emi_dlist_radixSort(dlist);
+        return;
+    }
+    _emi_dlist_betterSortByOrder(dlist, _common_orderFunction(dlist->data_type));
+    return;
+}
+
+void emi_dlist_betterSortByOrder(Dlist *dlist, int(*order)(void*, void*)) {
+    /* pdqsort, so O(n log n) but not stable */
+    STATS_CALL(dlist, betterSortByOrder);
+    _emi_dlist_betterSortByOrder(dlist, order);
+    return;
+}
+
+void emi_dlist_stableSort(Dlist *dlist) {
+    STATS_CALL(dlist, stableSort);
+    _emi_dlist_stableSort(dlist);
+    return;
+}
+
+void emi_dlist_stableSortByOrder(Dlist *dlist, int(*order)(void*, void*)) {
+    /* merge sort, elements which are equal according to the order
+    keep the order they had, but it needs a buffer as large as the list */
+    STATS_CALL(dlist, stableSortByOrder);
+    _emi_dlist_stableSortByOrder(dlist, order);
+    return;
+}
+
+
+
+void emi_dlist_radixSort(Dlist *dlist) {
+    /* uses the datatype to sort: ints and floats by value, chars by
+    their number. Other datatypes don't have a key, so those just
+    get the stable sort with the default order */
+    STATS_CALL(dlist, radixSort);
+    _emi_dlist_radixSort(dlist);
+    return;
+}
+
+
+
+typedef struct {
+    char     *data;
+    ptrdiff_t length;
+    char     *left;
+    ptrdiff_t left_length;
+    char     *right;
+    ptrdiff_t right_length;
+    char     *output;
+    ptrdiff_t output_start; /* which part of the merged output this task writes */
+    ptrdiff_t output_end;
+    int       data_size;
+    int     (*order)(void*, void*);
+    int       failed;
+} _EmiDlistSortTask;
+
+void *_emi_dlist_sortTask(void *argument) {
+    _EmiDlistSortTask *task = (_EmiDlistSortTask*) argument;
+    task->failed = _common_stableSort(task->data, task->length, task->data_size, task->order);
+    return NULL;
+}
+
+void *_emi_dlist_mergeTask(void *argument) {
+    _EmiDlistSortTask *task = (_EmiDlistSortTask*) argument;
+    ptrdiff_t left_start = _common_mergeSplit(task->left, task->left_length, task->right, task->right_length, task->output_start, task->data_size, task->order);
+    ptrdiff_t left_end   = _common_mergeSplit(task->left, task->left_length, task->right, task->right_length, task->output_end,   task->data_size, task->order);
+    ptrdiff_t right_start = task->output_start - left_start;
+    ptrdiff_t right_end   = task->output_end   - left_end;
+
+    _common_merge(task->left  + left_start  * task->data_size, left_end  - left_start,
+                  task->right + right_start * task->data_size, right_end - right_start,
+                  task->output + task->output_start * task->data_size, task->data_size, task->order);
+    return NULL;
+}
+
+void _emi_dlist_runTasks(void *(*function)(void*), _EmiDlistSortTask *tasks, int task_count) {
+    /* runs every task on its own thread, except the last one, which the
+    calling thread does itself. If a thread can't be made, its task is
+    just done on this thread as well */
+    pthread_t threads[task_count];
+    bool started[task_count];
+
+    for(int i=0; i<task_count-1; i++)
+        started[i] = pthread_create(&threads[i], NULL, function, &tasks[i]) == 0;
+    function(&tasks[task_count-1]);
+
+    for(int i=0; i<task_count-1; i++) {
+        if(started[i])
+            pthread_join(threads[i], NULL);
+        else
+            function(&tasks[i]);
+    }
+}
+
+void emi_dlist_parallelSort(Dlist *dlist, int(*order)(void*, void*), int threads) {
+    /* splits the dlist into a chunk per thread, stable sorts every chunk,
+    and then merges the chunks pairwise, where every merge is split over
+    the threads as well. If order is NULL the default order is used.
+    This gives exactly the same result as emi_dlist_stableSortByOrder */
+    STATS_CALL(dlist, parallelSort);
+    if(_emi_dlist_own(dlist) == 1) return;
+    if(order == NULL) order = _common_orderFunction(dlist->data_type);
+
+    ptrdiff_t length = dlist->size;
+    int data_size = dlist->data_size;
+    if(threads > length / PARALLEL_SORT_MIN_CHUNK) threads = length / PARALLEL_SORT_MIN_CHUNK;
+    if(threads <= 1) {
+        _emi_dlist_stableSortByOrder(dlist, order);
+        return;
+    }
+
+    char *buffer = (char*) malloc (length * data_size);
+    _EmiDlistSortTask *tasks = (_EmiDlistSortTask*) calloc (2 * threads, sizeof(_EmiDlistSortTask));
+    ptrdiff_t *run_starts = (ptrdiff_t*) malloc ((threads + 1) * sizeof(ptrdiff_t));
+    if(buffer == NULL || tasks == NULL || run_starts == NULL) {
+        printf("malloc failed in emi_dlist_parallelSort :(\n");
+        free(buffer);
+        free(tasks);
+        free(run_starts);
+        _emi_dlist_stableSortByOrder(dlist, order);
+        return;
+    }
+
+    int run_count = threads;
+    for(int i=0; i<=run_count; i++)
+        run_starts[i] = length * i / run_count;
+
+    for(int i=0; i<run_count; i++) {
+        tasks[i].data      = dlist->data + run_starts[i] * data_size;
+        tasks[i].length    = run_starts[i+1] - run_starts[i];
+        tasks[i].data_size = data_size;
+        tasks[i].order     = order;
+    }
+    _emi_dlist_runTasks(_emi_dlist_sortTask, tasks, run_count);
+    for(int i=0; i<run_count; i++) {
+        if(tasks[i].failed) {
+            printf("can't sort :(\n");
+            free(buffer);
+            free(tasks);
+            free(run_starts);
+            return;
+        }
+    }
+
+    /* every round halves the amount of runs, going back and forth between
+    the dlist and the buffer */
+    char *source      = dlist->data;
+    char *destination = buffer;
+    while(run_count > 1) {
+        int task_count = 0;
+        for(int pair=0; pair+1<run_count; pair+=2) {
+            ptrdiff_t left_length  = run_starts[pair+1] - run_starts[pair];
+            ptrdiff_t right_length = run_starts[pair+2] - run_starts[pair+1];
+            ptrdiff_t pair_length  = left_length + right_length;
+
+            /* bigger pairs get more threads. Every pair gets at least one,
+            so there can be up to one and a half task per thread */
+            int segments = threads * pair_length / length;
+            if(segments < 1) segments = 1;
+
+            for(int segment=0; segment<segments; segment++) {
+                _EmiDlistSortTask *task = &tasks[task_count++];
+                task->left         = source + run_starts[pair]   * data_size;
+                task->left_length  = left_length;
+                task->right        = source + run_starts[pair+1] * data_size;
+                task->right_length = right_length;
+                task->output       = destination + run_starts[pair] * data_size;
+                task->output_start = pair_length * segment / segments;
+                task->output_end   = pair_length * (segment + 1) / segments;
+                task->data_size    = data_size;
+                task->order        = order;
             }
-            current_item += dlist->data_size;
         }
+        _emi_dlist_runTasks(_emi_dlist_mergeTask, tasks, task_count);
+
+        /* an odd run out doesn't have a partner, it just moves over */
+        if(run_count % 2 == 1) {
+            ptrdiff_t start = run_starts[run_count-1];
+            memcpy(destination + start * data_size, source + start * data_size, (length - start) * data_size);
+        }
+
+        int new_run_count = 0;
+        for(int i=0; i<run_count; i+=2)
+            run_starts[new_run_count++] = run_starts[i];
+        run_starts[new_run_count] = length;
+        run_count = new_run_count;
+
+        char *swap  = source;
+        source      = destination;
+        destination = swap;
     }
 
+    if(source != dlist->data)
+        memcpy(dlist->data, source, length * data_size);
+
+    free(buffer);
+    free(tasks);
+    free(run_starts);
     return;
-} /* very shitty */
-
+}
 
 
 
+void emi_dlist_bubbleSort(Dlist *dlist) {
+    /* not a bubble sort anymore, but it was stable, 
+    so the stable sort gives the exact same result */
+    STATS_CALL(dlist, bubbleSort);
+    _emi_dlist_stableSort(dlist);
+    return;
+}
 
 void emi_dlist_bubbleSortByOrder(Dlist *dlist, int(*order)(void*, void*)) {
-    for(int i=emi_dlist_size(dlist) - 1; i>0; i--) {
-        char *current_item = dlist->data;
-        for(int j=0; j<i; j++) {
-            if(order(current_item, current_item + dlist->data_size) == -1) {
-                emi_dlist_swap(dlist, j, j+1);
-            }
-            current_item += dlist->data_size;
-        }
-    }
-
+    STATS_CALL(dlist, bubbleSortByOrder);
+    _emi_dlist_stableSortByOrder(dlist, order);
     return;
-
 }
 
 
@@ -335,8 +1323,10 @@ void emi_dlist_bubbleSortByOrder(Dlist *dlist, int(*order)(void*, void*)) {
 
 
 void emi_dlist_reverse(Dlist *dlist) {
-    for(int i=0; i<emi_dlist_size(dlist) / 2; i++) {
-        emi_dlist_swap(dlist, i, emi_dlist_size(dlist) - i - 1);
+    STATS_CALL(dlist, reverse);
+    if(_emi_dlist_own(dlist) == 1) return;
+    for(ptrdiff_t i=0; i<dlist->size / 2; i++) {
+        _emi_dlist_swap(dlist, i, dlist->size - i - 1);
     }
     return;
 }
@@ -344,19 +1334,15 @@ void emi_dlist_reverse(Dlist *dlist) {
 
 // /*--------------- THINNENING CHANGING FUNCTIONS ---------------*/
 void emi_dlist_filter(Dlist *dlist, bool(*condition)(void*)) {
-    bool keep[emi_dlist_size(dlist)];
-
-    char *current_item = dlist->data;
-    for(int i=0; i<emi_dlist_size(dlist); i++) {
-        keep[i] = condition(current_item);
-        current_item += dlist->data_size;
-    }
-
+    /* the write position never gets ahead of the read position, so this
+    can be done in one go, without a mask as large as the dlist */
+    STATS_CALL(dlist, filter);
+    if(_emi_dlist_own(dlist) == 1) return;
     char *current_read  = dlist->data;
     char *current_write = dlist->data;
-    int new_size = 0;
-    for(int i=0; i<emi_dlist_size(dlist); i++) {
-        if(keep[i]) {
+    ptrdiff_t new_size = 0;
+    for(ptrdiff_t i=0; i<dlist->size; i++) {
+        if(condition(current_read)) {
             if(current_read != current_write)
                 memcpy(current_write, current_read, dlist->data_size);
             current_write += dlist->data_size;
@@ -366,76 +1352,149 @@ void emi_dlist_filter(Dlist *dlist, bool(*condition)(void*)) {
     }
 
     dlist->size = new_size;
+    _emi_dlist_autoShrink(dlist);
     return;
 }
 
+void emi_dlist_filterBlock(Dlist *dlist, void(*condition)(void*, bool*, int)) {
+    /* condition gets up to BLOCK_SIZE elements at a time, and writes for
+    every one of them if it's kept into the mask */
+    STATS_CALL(dlist, filterBlock);
+    if(_emi_dlist_own(dlist) == 1) return;
+    bool keep[BLOCK_SIZE];
+    char *current_read  = dlist->data;
+    char *current_write = dlist->data;
+    ptrdiff_t new_size = 0;
+
+    for(ptrdiff_t start=0; start<dlist->size; start+=BLOCK_SIZE) {
+        int count = dlist->size - start < BLOCK_SIZE ? dlist->size - start : BLOCK_SIZE;
+        condition(current_read, keep, count);
+
+        /* the kept elements are moved as runs instead of one by one */
+        int i = 0;
+        while(i < count) {
+            if(!keep[i]) {
+                i++;
+                continue;
+            }
+            int run_start = i;
+            while(i < count && keep[i]) i++;
+            int run_bytes = (i - run_start) * dlist->data_size;
+            if(current_write != current_read + run_start * dlist->data_size)
+                memmove(current_write, current_read + run_start * dlist->data_size, run_bytes);
+            current_write += run_bytes;
+            new_size += i - run_start;
+        }
+        current_read += count * dlist->data_size;
+    }
+
+    dlist->size = new_size;
+    _emi_dlist_autoShrink(dlist);
+    return;
+}
 
 
 
-void emi_dlist_removeDuplicates(Dlist *dlist) {
 
-    bool delete[emi_dlist_size(dlist)];
-    for(int i=0; i<emi_dlist_size(dlist); i++) {
-        delete[i] = false;
-    }
+void _emi_dlist_removeDuplicates(Dlist *dlist) {
+    /* keeps the first occurrence of every element. Every element is
+    compared with the ones we've kept so far, which are all before
+    the write position, so they never get overwritten */
+    ptrdiff_t size = dlist->size;
+    if(size < 2 || _emi_dlist_own(dlist) == 1) return;
 
-    char *current_item = dlist->data + dlist->data_size;
-    for(int i=1; i<emi_dlist_size(dlist); i++) {
-        char *compare_item = dlist->data;
-        for(int j=0; j<i; j++) {
-            if(memcmp(current_item, compare_item, dlist->data_size) == 0) {
-                delete[i] = true;
-                break;
+    char *current_read  = dlist->data;
+    char *current_write = dlist->data;
+    ptrdiff_t new_size = 0;
+
+    if(size <= SMALL_DUPLICATES) {
+        for(ptrdiff_t i=0; i<size; i++) {
+            char *compare_item = dlist->data;
+            bool duplicate = false;
+            for(ptrdiff_t j=0; j<new_size; j++) {
+                if(memcmp(current_read, compare_item, dlist->data_size) == 0) {
+                    duplicate = true;
+                    break;
+                }
+                compare_item += dlist->data_size;
             }
-            compare_item += dlist->data_size;
+            if(!duplicate) {
+                if(current_read != current_write)
+                    memcpy(current_write, current_read, dlist->data_size);
+                current_write += dlist->data_size;
+                new_size++;
+            }
+            current_read += dlist->data_size;
         }
-        current_item += dlist->data_size;
+        dlist->size = new_size;
+        _emi_dlist_autoShrink(dlist);
+        return;
     }
 
-    char *current_read  = dlist->data;
-    char *current_write = dlist->data;
-    int new_size = 0;
-    for(int i=0; i<emi_dlist_size(dlist); i++) {
-        if(!delete[i]) {
+    _EmiDlistIndexSet set;
+    if(_emi_dlist_indexSetInit(&set, dlist->data, dlist->data_size, dlist->data_size, size) == 1) {
+        printf("can't remove duplicates :(\n");
+        return;
+    }
+
+    for(ptrdiff_t i=0; i<size; i++) {
+        ptrdiff_t *slot = _emi_dlist_indexSetFind(&set, current_read);
+        if(*slot == -1) {
             if(current_read != current_write)
                 memcpy(current_write, current_read, dlist->data_size);
+            *slot = new_size;
             current_write += dlist->data_size;
             new_size++;
         }
         current_read += dlist->data_size;
     }
 
+    _emi_dlist_indexSetFree(&set);
     dlist->size = new_size;
+    _emi_dlist_autoShrink(dlist);
+    return;
+}
+
+void emi_dlist_removeDuplicates(Dlist *dlist) {
+    STATS_CALL(dlist, removeDuplicates);
+    _emi_dlist_removeDuplicates(dlist);
     return;
 }
 
 
 
 // /*--------------- OUTPUT FUNCTIONS ---------------*/
-void emi_dlist_print(Dlist *dlist) {
-    if(dlist->data == NULL) {
+void _emi_dlist_viewPrint(DlistView view) {
+    if(view.data == NULL) {
         printf("the data is NULL, can't print\n");
         return;
     }
-    if(dlist->data_type == DATA_TYPE_DEF) {
+    if(view.data_type == DATA_TYPE_DEF) {
         printf("can't print default data type\n");
         return;
     }
 
-    char *current_item = dlist->data;
+    char *current_item = view.data;
     printf("{");
-    for(int i=0; i<emi_dlist_size(dlist); i++) {
-        _common_printData(current_item, dlist->data_size, dlist->data_type);
-        if(i < emi_dlist_size(dlist) - 1) {
+    for(ptrdiff_t i=0; i<view.size; i++) {
+        _common_printData(current_item, view.data_size, view.data_type);
+        if(i < view.size - 1) {
             printf(", ");
         }
-        current_item += dlist->data_size;
+        current_item += view.stride;
     }
     printf("}\n");
     return;
 }
 
+void emi_dlist_print(Dlist *dlist) {
+    STATS_CALL(dlist, print);
+    _emi_dlist_viewPrint(_emi_dlist_asView(dlist));
+    return;
+}
+
 void emi_dlist_printString(Dlist *dlist) {
+    STATS_CALL(dlist, printString);
     if(dlist->data == NULL) {
         printf("the data is NULL, can't print\n");
         return;
@@ -445,14 +1504,15 @@ void emi_dlist_printString(Dlist *dlist) {
     //     return;
     // }
     
-    _common_printData(dlist->data, emi_dlist_size(dlist), DATA_TYPE_STR);
+    _common_printData(dlist->data, (int) dlist->size, DATA_TYPE_STR);
 
-    // for(int i=0; i<emi_dlist_size(dlist); i++)
+    // for(int i=0; i<dlist->size; i++)
     //     _common_printData(dlist->data, dlist->data_size, dlist->data_type);
     return;
 }
 
 void emi_dlist_sprintString(char *buffer, Dlist *dlist) {
+    STATS_CALL(dlist, sprintString);
   if(dlist->data == NULL) {
     printf("the data is NULL, can't print\n");
     return;
@@ -462,62 +1522,276 @@ void emi_dlist_sprintString(char *buffer, Dlist *dlist) {
     return;
   }
 
-  sprintf(buffer, "%.*s", emi_dlist_size(dlist), (char*) dlist->data);
-  buffer[emi_dlist_size(dlist)] = '\0';
+  sprintf(buffer, "%.*s", (int) dlist->size, (char*) dlist->data);
+  buffer[dlist->size] = '\0';
   return;
 }
 
 
 // /*--------------- SEARCHING FUNCTIONS ---------------*/
-int emi_dlist_find(Dlist *dlist, void *data) {
-    char* current_item = dlist->data;
-    for(int i=0; i<emi_dlist_size(dlist); i++) {
-        if(memcmp(current_item, data, dlist->data_size) == 0)
+ptrdiff_t _emi_dlist_viewFind(DlistView view, void *data) {
+    if(_emi_dlist_viewIsContiguous(&view))
+        return _common_find(view.data, view.size, view.data_size, data); /* -1 if the item doesn't exist */
+    char *current_item = view.data;
+    for(ptrdiff_t i=0; i<view.size; i++) {
+        if(memcmp(current_item, data, view.data_size) == 0)
             return i;
-        current_item += dlist->data_size;
+        current_item += view.stride;
     }
+    return -1;
+}
 
-    return -1; /*if the item doesn't exist*/
+ptrdiff_t _emi_dlist_viewCount(DlistView view, void *data) {
+    if(_emi_dlist_viewIsContiguous(&view))
+        return _common_count(view.data, view.size, view.data_size, data);
+    ptrdiff_t count = 0;
+    char *current_item = view.data;
+    for(ptrdiff_t i=0; i<view.size; i++) {
+        count += memcmp(current_item, data, view.data_size) == 0;
+        current_item += view.stride;
+    }
+    return count;
 }
 
-int emi_dlist_findByCondition(Dlist *dlist, bool(*condition)(void*)) {
-    char* current_item = dlist->data;
-    for(int i=0; i<emi_dlist_size(dlist); i++) {
+ptrdiff_t _emi_dlist_viewFindByCondition(DlistView view, bool(*condition)(void*)) {
+    char* current_item = view.data;
+    for(ptrdiff_t i=0; i<view.size; i++) {
         if(condition(current_item))
             return i;
-        current_item += dlist->data_size;
+        current_item += view.stride;
     }
 
     return -1; /*if the item doesn't exist*/
 }
 
+Dlist *_emi_dlist_viewFindAll(DlistView view, void *data) {
+    Dlist *output = _emi_dlist_create(sizeof(ptrdiff_t), DATA_TYPE_DEF, DEFAULT_INITIAL_SIZE, DEFAULT_GROWTH_EXPONENTIAL, 0, NULL);
+    if(output == NULL) {
+        printf("malloc failed in emi_dlist_findAll :(\n");
+        return NULL;
+    }
+    if(!_emi_dlist_viewIsContiguous(&view)) {
+        char *current_item = view.data;
+        for(ptrdiff_t i=0; i<view.size; i++) {
+            if(memcmp(current_item, data, view.data_size) == 0)
+                _emi_dlist_append(output, &i);
+            current_item += view.stride;
+        }
+        return output;
+    }
+
+    /* the indices get written straight into the output, and whenever
+    it's full, it grows and we continue after the last index found */
+    ptrdiff_t start = 0;
+    while(true) {
+        ptrdiff_t capacity = output->max_size - output->size;
+        ptrdiff_t found = _common_findMany(view.data, start, view.size, view.data_size, data, (ptrdiff_t*) output->data + output->size, capacity);
+        output->size += found;
+        if(found < capacity) break;
+
+        start = ((ptrdiff_t*) output->data)[output->size - 1] + 1;
+        if(_emi_dlist_grow(output, -1) == 1) {
+            printf("can't find all :(\n");
+            break;
+        }
+    }
 
-Dlist *emi_dlist_findAll(Dlist *dlist, void *data) {
-    Dlist *output = emi_dlist_create(sizeof(int), DATA_TYPE_INT);
+    return output; /* empty if the item doesn't exist */
+}
 
-    char* current_item = dlist->data;
-    for(int i=0; i<emi_dlist_size(dlist); i++) {
-        if(memcmp(current_item, data, dlist->data_size) == 0)
-            emi_dlist_append(output, &i);
-        current_item += dlist->data_size;
+Dlist *_emi_dlist_viewFindAllByCondition(DlistView view, bool(*condition)(void*)) {
+    Dlist *output = _emi_dlist_create(sizeof(ptrdiff_t), DATA_TYPE_DEF, DEFAULT_INITIAL_SIZE, DEFAULT_GROWTH_EXPONENTIAL, 0, NULL);
+    if(output == NULL) {
+        printf("malloc failed in emi_dlist_findAllByCondition :(\n");
+        return NULL;
+    }
+
+    char* current_item = view.data;
+    for(ptrdiff_t i=0; i<view.size; i++) {
+        if(condition(current_item))
+            _emi_dlist_append(output, &i);
+        current_item += view.stride;
     }
 
     return output; /*if the item doesn't exist*/
 }
 
+ptrdiff_t emi_dlist_find(Dlist *dlist, void *data) {
+    STATS_CALL(dlist, find);
+    return _emi_dlist_viewFind(_emi_dlist_asView(dlist), data);
+}
+
+ptrdiff_t emi_dlist_count(Dlist *dlist, void *data) {
+    STATS_CALL(dlist, count);
+    return _emi_dlist_viewCount(_emi_dlist_asView(dlist), data);
+}
+
+ptrdiff_t emi_dlist_findByCondition(Dlist *dlist, bool(*condition)(void*)) {
+    STATS_CALL(dlist, findByCondition);
+    return _emi_dlist_viewFindByCondition(_emi_dlist_asView(dlist), condition);
+}
 
+Dlist *emi_dlist_findAll(Dlist *dlist, void *data) {
+    STATS_CALL(dlist, findAll);
+    return _emi_dlist_viewFindAll(_emi_dlist_asView(dlist), data);
+}
 
 Dlist *emi_dlist_findAllByCondition (Dlist *dlist, bool(*condition)(void*)) {
-    Dlist *output = emi_dlist_create(sizeof(int), DATA_TYPE_INT);
+    STATS_CALL(dlist, findAllByCondition);
+    return _emi_dlist_viewFindAllByCondition(_emi_dlist_asView(dlist), condition);
+}
 
-    char* current_item = dlist->data;
-    for(int i=0; i<emi_dlist_size(dlist); i++) {
-        if(condition(current_item))
-            emi_dlist_append(output, &i);
-        current_item += dlist->data_size;
+
+
+
+// /*--------------- SORTED FUNCTIONS ---------------*/
+/* these all expect the dlist to be sorted by the order that's passed,
+and if the order is NULL, the default order of the datatype is used */
+ptrdiff_t _emi_dlist_viewLowerBound(DlistView view, void *data, int(*order)(void*, void*)) {
+    /* the first index where the element doesn't come before data, or
+    the size if there isn't one. The loop doesn't branch on the result
+    of the comparison, so the compiler can use a conditional move */
+    if(order == NULL) order = _common_orderFunction(view.data_type);
+    ptrdiff_t length = view.size;
+    if(length == 0) return 0;
+
+    char *base = view.data;
+    while(length > 1) {
+        ptrdiff_t half = length / 2;
+        base = (order(base + (half - 1) * view.stride, data) > 0) ? base + half * view.stride : base;
+        length -= half;
+    }
+    return (base - view.data) / view.stride + (order(base, data) > 0);
+}
+
+ptrdiff_t _emi_dlist_viewUpperBound(DlistView view, void *data, int(*order)(void*, void*)) {
+    /* the first index where data comes before the element, or the size */
+    if(order == NULL) order = _common_orderFunction(view.data_type);
+    ptrdiff_t length = view.size;
+    if(length == 0) return 0;
+
+    char *base = view.data;
+    while(length > 1) {
+        ptrdiff_t half = length / 2;
+        base = (order(data, base + (half - 1) * view.stride) > 0) ? base : base + half * view.stride;
+        length -= half;
     }
+    return (base - view.data) / view.stride + (order(data, base) <= 0);
+}
 
-    return output; /*if the item doesn't exist*/
+ptrdiff_t _emi_dlist_viewBinarySearch(DlistView view, void *data, int(*order)(void*, void*)) {
+    /* like emi_dlist_find, but O(log n). Returns the first element
+    that's equal according to the order, or -1 */
+    if(order == NULL) order = _common_orderFunction(view.data_type);
+    ptrdiff_t index = _emi_dlist_viewLowerBound(view, data, order);
+    if(index == view.size) return -1;
+    if(order(view.data + index * view.stride, data) != 0) return -1;
+    return index;
+}
+
+ptrdiff_t emi_dlist_lowerBound(Dlist *dlist, void *data, int(*order)(void*, void*)) {
+    STATS_CALL(dlist, lowerBound);
+    return _emi_dlist_viewLowerBound(_emi_dlist_asView(dlist), data, order);
+}
+
+ptrdiff_t emi_dlist_upperBound(Dlist *dlist, void *data, int(*order)(void*, void*)) {
+    STATS_CALL(dlist, upperBound);
+    return _emi_dlist_viewUpperBound(_emi_dlist_asView(dlist), data, order);
+}
+
+ptrdiff_t emi_dlist_binarySearch(Dlist *dlist, void *data, int(*order)(void*, void*)) {
+    STATS_CALL(dlist, binarySearch);
+    return _emi_dlist_viewBinarySearch(_emi_dlist_asView(dlist), data, order);
+}
+
+void emi_dlist_insertSorted(Dlist *dlist, void *data, int(*order)(void*, void*)) {
+    /* goes after the elements that are equal to it, so inserting
+    things one by one keeps the order they came in */
+    STATS_CALL(dlist, insertSorted);
+    _emi_dlist_insertRange(dlist, data, 1, _emi_dlist_viewUpperBound(_emi_dlist_asView(dlist), data, order));
+    return;
+}
+
+Dlist *emi_dlist_mergeSorted(Dlist *dlist_one, Dlist *dlist_two, int(*order)(void*, void*)) {
+    /* merges two sorted dlists into a new sorted one. If elements are
+    equal, the ones from dlist_one come first */
+    STATS_CALL(dlist_one, mergeSorted);
+    if(dlist_one->data_size != dlist_two->data_size) {
+        printf("!!!BIG WARNING!!! you're tryna merge a list with a list that has another datasize\n");
+        return NULL;
+    }
+    if(dlist_one->data_type != dlist_two->data_type)
+        printf("!small warning! you're tryna merge a list with a list that has another datatype\n");
+    if(order == NULL) order = _common_orderFunction(dlist_one->data_type);
+
+    ptrdiff_t size = dlist_one->size + dlist_two->size;
+    Dlist *output = _emi_dlist_create(dlist_one->data_size, dlist_one->data_type, size > 0 ? size : DEFAULT_INITIAL_SIZE, dlist_one->growth_exponential, 0, NULL);
+    if(output == NULL) {
+        printf("malloc failed in emi_dlist_mergeSorted :(\n");
+        return NULL;
+    }
+    _common_merge(dlist_one->data, dlist_one->size, dlist_two->data, dlist_two->size, output->data, output->data_size, order);
+    output->size = size;
+    return output;
+}
+
+
+ptrdiff_t _emi_dlist_fillEytzinger(Dlist *sorted, char *output, ptrdiff_t sorted_index, ptrdiff_t eytzinger_index) {
+    /* walks the implicit tree in order, which is the sorted order */
+    if(eytzinger_index > sorted->size) return sorted_index;
+    sorted_index = _emi_dlist_fillEytzinger(sorted, output, sorted_index, 2 * eytzinger_index);
+    memcpy(output + (eytzinger_index - 1) * sorted->data_size, sorted->data + sorted_index * sorted->data_size, sorted->data_size);
+    sorted_index++;
+    return _emi_dlist_fillEytzinger(sorted, output, sorted_index, 2 * eytzinger_index + 1);
+}
+
+Dlist *emi_dlist_createEytzinger(Dlist *sorted) {
+    /* makes a copy of a sorted dlist in eytzinger order: the layout of a
+    binary heap, so the root is first, then its two children, and so on.
+    Searching that touches way fewer cache lines, so it's good for big
+    lookup tables. Use emi_dlist_eytzingerSearch on the result */
+    STATS_CALL(sorted, createEytzinger);
+    Dlist *output = _emi_dlist_create(sorted->data_size, sorted->data_type, sorted->size > 0 ? sorted->size : DEFAULT_INITIAL_SIZE, sorted->growth_exponential, 0, NULL);
+    if(output == NULL) {
+        printf("malloc failed in emi_dlist_createEytzinger :(\n");
+        return NULL;
+    }
+    _emi_dlist_fillEytzinger(sorted, output->data, 0, 1);
+    output->size = sorted->size;
+    return output;
+}
+
+ptrdiff_t _emi_dlist_eytzingerLowerBound(Dlist *eytzinger, void *data, int(*order)(void*, void*)) {
+    /* the index (in the eytzinger dlist) of the smallest element that
+    doesn't come before data, or -1 if there isn't one */
+    if(order == NULL) order = _common_orderFunction(eytzinger->data_type);
+    ptrdiff_t length = eytzinger->size;
+    char *base = eytzinger->data - eytzinger->data_size; /* the tree is 1-indexed */
+
+    ptrdiff_t k = 1;
+    while(k <= length) {
+        /* the descendants 4 levels down are next to each other, so get them into the cache already */
+        __builtin_prefetch(base + 16 * k * eytzinger->data_size);
+        k = 2 * k + (order(base + k * eytzinger->data_size, data) > 0);
+    }
+    /* k went right (to a smaller element) every time after the answer, undo those steps */
+    k >>= __builtin_ffsll(~k);
+    return k - 1;
+}
+
+ptrdiff_t emi_dlist_eytzingerLowerBound(Dlist *eytzinger, void *data, int(*order)(void*, void*)) {
+    STATS_CALL(eytzinger, eytzingerLowerBound);
+    return _emi_dlist_eytzingerLowerBound(eytzinger, data, order);
+}
+
+ptrdiff_t emi_dlist_eytzingerSearch(Dlist *eytzinger, void *data, int(*order)(void*, void*)) {
+    /* returns the index (in the eytzinger dlist) of an element equal to data, or -1 */
+    STATS_CALL(eytzinger, eytzingerSearch);
+    if(order == NULL) order = _common_orderFunction(eytzinger->data_type);
+    ptrdiff_t index = _emi_dlist_eytzingerLowerBound(eytzinger, data, order);
+    if(index == -1) return -1;
+    if(order(eytzinger->data + index * eytzinger->data_size, data) != 0) return -1;
+    return index;
 }
 
 
@@ -525,47 +1799,78 @@ Dlist *emi_dlist_findAllByCondition (Dlist *dlist, bool(*condition)(void*)) {
 
 // /*--------------- SET THEORY FUNCTIONS ---------------*/
 Dlist *emi_dlist_uniqueElements(Dlist *dlist) {
-    Dlist *new_dlist = emi_dlist_createCopy(dlist);
-    emi_dlist_removeDuplicates(new_dlist);
+    STATS_CALL(dlist, uniqueElements);
+    Dlist *new_dlist = _emi_dlist_createCopy(dlist);
+    if(new_dlist != NULL) _emi_dlist_removeDuplicates(new_dlist);
     return new_dlist;
 }
 
-Dlist *emi_dlist_intersection(Dlist *emi_dlist_one, Dlist *emi_dlist_two) {
-    if(emi_dlist_one->data_size != emi_dlist_two->data_size)
+Dlist *_emi_dlist_viewIntersection(DlistView view_one, DlistView view_two, float growth_exponential) {
+    if(view_one.data_size != view_two.data_size)
         printf("!!!BIG WARNING!!! you're tryna intersect a list with a list that has another datasize\n");
-    if(emi_dlist_one->data_type != emi_dlist_two->data_type)
+    if(view_one.data_type != view_two.data_type)
         printf("!small warning! you're tryna intersect a list with a list that has another datatype\n");
 
-    /* we're looping through list_two a lot, but only once 
-    through list_one, so if list_two is larger, we should swap
-    them */
-    if (emi_dlist_one->size < emi_dlist_two->size) {
-        Dlist *buffer = emi_dlist_one;
-        emi_dlist_one = emi_dlist_two;
-        emi_dlist_two = buffer;
+    /* view_two goes into the hash set, so if view_two is larger,
+    we should swap them (the output follows the order of view_one) */
+    if (view_one.size < view_two.size) {
+        DlistView buffer = view_one;
+        view_one = view_two;
+        view_two = buffer;
     }
     
     /* we take the size of the second array, since the maximal size is that 
     of the smaller of the two arrays, which is the second one */
-    Dlist *output = emi_dlist_createWithParas(emi_dlist_one->data_size, emi_dlist_one->data_type, emi_dlist_two->size, emi_dlist_two->growth_exponential);
+    Dlist *output = _emi_dlist_create(view_one.data_size, view_one.data_type, view_two.size, growth_exponential, 0, NULL);
+    if(output == NULL) {
+        printf("malloc failed in emi_dlist_intersection :(\n");
+        return NULL;
+    }
+
+    /* the smaller list goes into a hash set, then we go through the larger one
+    in order and take every element that's in the set. Slots get marked as
+    taken when we output them, so every element is only output once */
+    _EmiDlistIndexSet set;
+    if(_emi_dlist_indexSetInit(&set, view_two.data, view_two.stride, view_two.data_size, view_two.size) == 1) {
+        printf("can't intersect :(\n");
+        return output;
+    }
 
+    char *current_item = view_two.data;
+    for(ptrdiff_t i=0; i<view_two.size; i++) {
+        ptrdiff_t *slot = _emi_dlist_indexSetFind(&set, current_item);
+        if(*slot == -1) *slot = i;
+        current_item += view_two.stride;
+    }
 
-    char *current_item = emi_dlist_one->data;
-    for(int i=0; i<emi_dlist_one->size; i++) {
-        if(emi_dlist_find(emi_dlist_two, current_item) != -1)
-            emi_dlist_append(output, current_item);
-        current_item += emi_dlist_one->data_size;
+    current_item = view_one.data;
+    for(ptrdiff_t i=0; i<view_one.size; i++) {
+        ptrdiff_t *slot = _emi_dlist_indexSetFind(&set, current_item);
+        if(*slot >= 0) {
+            _emi_dlist_append(output, current_item);
+            *slot = -*slot - 2;
+        }
+        current_item += view_one.stride;
     }
 
-    emi_dlist_removeDuplicates(output);
+    _emi_dlist_indexSetFree(&set);
     return output;
 }
 
+Dlist *emi_dlist_intersection(Dlist *emi_dlist_one, Dlist *emi_dlist_two) {
+    STATS_CALL(emi_dlist_one, intersection);
+    /* the output grows like the smaller one, which is the one that fits */
+    Dlist *smaller = emi_dlist_one->size < emi_dlist_two->size ? emi_dlist_one : emi_dlist_two;
+    return _emi_dlist_viewIntersection(_emi_dlist_asView(emi_dlist_one), _emi_dlist_asView(emi_dlist_two), smaller->growth_exponential);
+}
+
 
 Dlist *emi_dlist_union(Dlist *emi_dlist_one, Dlist *emi_dlist_two) {
-    Dlist *output = emi_dlist_createCopy(emi_dlist_one);
-    emi_dlist_extendByDlist(output, emi_dlist_two);
-    emi_dlist_removeDuplicates(output);
+    STATS_CALL(emi_dlist_one, union);
+    Dlist *output = _emi_dlist_createCopy(emi_dlist_one);
+    if(output == NULL) return NULL;
+    _emi_dlist_appendView(output, _emi_dlist_asView(emi_dlist_two));
+    _emi_dlist_removeDuplicates(output);
     return output;
 }
 
@@ -580,9 +1885,11 @@ void emi_dlist_map(Dlist *dlist, void(*map)(void*, void*)) {
     be of the same type as the list contains, and the
     second one as well, and it's where the output is
     written */
+    STATS_CALL(dlist, map);
+    if(_emi_dlist_own(dlist) == 1) return;
     char buffer[dlist->data_size];
     char *current_item = dlist->data;
-    for(int i=0; i<emi_dlist_size(dlist); i++) {
+    for(ptrdiff_t i=0; i<dlist->size; i++) {
         /* we use a buffer in case the result data is used
         multiple times. Otherwise, the map could try to
         reuse the data, even if we have already changed it
@@ -595,7 +1902,32 @@ void emi_dlist_map(Dlist *dlist, void(*map)(void*, void*)) {
     return;
 }
 
-void emi_dlist_reduce(Dlist *dlist, void(*map)(void*, void*), void *output) {
+void emi_dlist_mapBlock(Dlist *dlist, void(*map)(void*, void*, int)) {
+    /* map(in, out, count) gets up to BLOCK_SIZE elements at a time, and
+    writes the results to out. out is a separate buffer for the same
+    reason as in emi_dlist_map, and it's copied back per block */
+    STATS_CALL(dlist, mapBlock);
+    if(_emi_dlist_own(dlist) == 1) return;
+    int block_bytes = (dlist->size < BLOCK_SIZE ? dlist->size : BLOCK_SIZE) * dlist->data_size;
+    char *buffer = (char*) malloc (block_bytes + 1);
+    if(buffer == NULL) {
+        printf("malloc failed in emi_dlist_mapBlock :(\n");
+        return;
+    }
+
+    char *current_item = dlist->data;
+    for(ptrdiff_t start=0; start<dlist->size; start+=BLOCK_SIZE) {
+        int count = dlist->size - start < BLOCK_SIZE ? dlist->size - start : BLOCK_SIZE;
+        map(current_item, buffer, count);
+        memcpy(current_item, buffer, count * dlist->data_size);
+        current_item += count * dlist->data_size;
+    }
+
+    free(buffer);
+    return;
+}
+
+void _emi_dlist_viewReduce(DlistView view, void(*map)(void*, void*), void *output) {
     /* the map function should have the first argument
     be of the same type as the list contains, and the
     second one of the desired output type, and it's 
@@ -608,12 +1940,265 @@ void emi_dlist_reduce(Dlist *dlist, void(*map)(void*, void*), void *output) {
     whatever is at output at the calling of the function,
     and the size is implied in how map uses it 
     nice and long comment :3 */
-    char *current_item = dlist->data;
-    for(int i=0; i<emi_dlist_size(dlist); i++) {
+    char *current_item = view.data;
+    for(ptrdiff_t i=0; i<view.size; i++) {
         map(current_item, output);
+        current_item += view.stride;
+    }
+
+    return;
+}
+
+void emi_dlist_reduce(Dlist *dlist, void(*map)(void*, void*), void *output) {
+    STATS_CALL(dlist, reduce);
+    _emi_dlist_viewReduce(_emi_dlist_asView(dlist), map, output);
+    return;
+}
+
+void emi_dlist_reduceBlock(Dlist *dlist, void(*reduce)(void*, int, void*), void *output) {
+    /* reduce(in, count, output) gets up to BLOCK_SIZE elements at a time,
+    and output works the same as in emi_dlist_reduce */
+    STATS_CALL(dlist, reduceBlock);
+    char *current_item = dlist->data;
+    for(ptrdiff_t start=0; start<dlist->size; start+=BLOCK_SIZE) {
+        int count = dlist->size - start < BLOCK_SIZE ? dlist->size - start : BLOCK_SIZE;
+        reduce(current_item, count, output);
+        current_item += count * dlist->data_size;
+    }
+    return;
+}
+
+
+typedef struct {
+    Dlist    *dlist;
+    ptrdiff_t chunk_size;
+    void    (*map)(void*, void*);
+    void    (*combine)(void*, void*);
+    void     *identity;
+    int       output_size;
+    char     *partials; /* a result per chunk for parallelReduce */
+} _EmiDlistParallelJob;
+
+int _emi_dlist_chunkCount(Dlist *dlist, Pool *pool, ptrdiff_t *chunk_size) {
+    /* enough chunks per thread that there's something to steal */
+    int chunks = (pool == NULL ? 1 : emi_pool_threads(pool)) * POOL_CHUNKS_PER_THREAD;
+    *chunk_size = (dlist->size + chunks - 1) / chunks;
+    if(*chunk_size < 1) *chunk_size = 1;
+    return (dlist->size + *chunk_size - 1) / *chunk_size;
+}
+
+void _emi_dlist_mapChunk(void *context, int chunk) {
+    _EmiDlistParallelJob *job = (_EmiDlistParallelJob*) context;
+    Dlist *dlist = job->dlist;
+    ptrdiff_t start = chunk * job->chunk_size;
+    ptrdiff_t end   = start + job->chunk_size < dlist->size ? start + job->chunk_size : dlist->size;
+
+    /* same as emi_dlist_map, every thread has its own buffer */
+    char buffer[dlist->data_size];
+    char *current_item = dlist->data + start * dlist->data_size;
+    for(ptrdiff_t i=start; i<end; i++) {
+        job->map(current_item, buffer);
+        memcpy(current_item, buffer, dlist->data_size);
+        current_item += dlist->data_size;
+    }
+}
+
+void _emi_dlist_reduceChunk(void *context, int chunk) {
+    _EmiDlistParallelJob *job = (_EmiDlistParallelJob*) context;
+    Dlist *dlist = job->dlist;
+    ptrdiff_t start = chunk * job->chunk_size;
+    ptrdiff_t end   = start + job->chunk_size < dlist->size ? start + job->chunk_size : dlist->size;
+
+    char *partial = job->partials + (size_t) chunk * job->output_size;
+    memcpy(partial, job->identity, job->output_size);
+    char *current_item = dlist->data + start * dlist->data_size;
+    for(ptrdiff_t i=start; i<end; i++) {
+        job->map(current_item, partial);
         current_item += dlist->data_size;
     }
+}
+
+
+void emi_dlist_parallelMap(Dlist *dlist, void(*map)(void*, void*), Pool *pool) {
+    /* emi_dlist_map, but the elements are spread over the threads of the
+    pool, so map can't depend on the order it's called in. With a NULL
+    pool it's all done on this thread */
+    STATS_CALL(dlist, parallelMap);
+    if(_emi_dlist_own(dlist) == 1) return;
+    _EmiDlistParallelJob job = { .dlist = dlist, .map = map };
+    int chunk_count = _emi_dlist_chunkCount(dlist, pool, &job.chunk_size);
+    _emi_pool_run(pool, _emi_dlist_mapChunk, &job, chunk_count);
+    return;
+}
+
+void emi_dlist_parallelReduce(Dlist *dlist, void(*map)(void*, void*), void(*combine)(void*, void*), void *identity, void *output, int output_size, Pool *pool) {
+    /* like emi_dlist_reduce, every chunk of the dlist is reduced with map,
+    but starting from a copy of identity (output_size bytes), instead of
+    from output. Then the result of every chunk is put into output with
+    combine(chunk_result, output), in the order of the chunks. So that
+    gives the same as emi_dlist_reduce as long as combine does the same
+    as map would do for all the elements of that chunk, like adding */
+    STATS_CALL(dlist, parallelReduce);
+    _EmiDlistParallelJob job = { .dlist = dlist, .map = map, .combine = combine, .identity = identity, .output_size = output_size };
+    int chunk_count = _emi_dlist_chunkCount(dlist, pool, &job.chunk_size);
+    job.partials = (char*) malloc ((size_t) chunk_count * output_size + 1);
+    if(job.partials == NULL) {
+        printf("malloc failed in emi_dlist_parallelReduce :(\n");
+        return;
+    }
+
+    _emi_pool_run(pool, _emi_dlist_reduceChunk, &job, chunk_count);
+    for(int i=0; i<chunk_count; i++)
+        combine(job.partials + (size_t) i * output_size, output);
+
+    free(job.partials);
+    return;
+}
+
+
+
+
+
+
+
+// /*--------------- VIEW FUNCTIONS ---------------*/
+/* a view is just a pointer with a size and a stride, so making one
+doesn't copy or allocate anything. The view versions of the dlist
+functions do the same work as those, the dlist functions just look at
+the whole dlist through a view */
+DlistView emi_dlist_view(Dlist *dlist) {
+    STATS_CALL(dlist, view);
+    return _emi_dlist_asView(dlist);
+}
+
+DlistView _emi_dlist_viewSlice(DlistView view, ptrdiff_t start_index, ptrdiff_t end_index, ptrdiff_t step) {
+    /* the elements from start_index up to (not including) end_index,
+    but only every step-th one of those. An empty view if the range
+    is empty or the step isn't positive */
+    _common_fixIndexInclusive(view.size, &start_index);
+    _common_fixIndexInclusive(view.size, &end_index);
+    if(step <= 0) {
+        printf("can't slice with a step of %td\n", step);
+        step = 1;
+        end_index = start_index;
+    }
+
+    DlistView slice = view;
+    slice.data   = view.data + start_index * view.stride;
+    slice.size   = end_index > start_index ? (end_index - start_index + step - 1) / step : 0;
+    slice.stride = view.stride * step;
+    return slice;
+}
+
+DlistView emi_dlist_viewSlice(DlistView view, ptrdiff_t start_index, ptrdiff_t end_index, ptrdiff_t step) {
+    STATS_CALL_GLOBAL(viewSlice);
+    return _emi_dlist_viewSlice(view, start_index, end_index, step);
+}
+
+DlistView emi_dlist_viewRange(Dlist *dlist, ptrdiff_t start_index, ptrdiff_t end_index) {
+    STATS_CALL(dlist, viewRange);
+    return _emi_dlist_viewSlice(_emi_dlist_asView(dlist), start_index, end_index, 1);
+}
+
+DlistView emi_dlist_viewFromArray(void *data, ptrdiff_t array_length, int data_size, int data_type) {
+    STATS_CALL_GLOBAL(viewFromArray);
+    DlistView view = { (char*) data, array_length, data_size, data_size, data_type };
+    return view;
+}
+
+void *_emi_dlist_viewReadRaw(DlistView view, ptrdiff_t index) {
+    if(view.size == 0) {
+        printf("can't read from empty view\n");
+        return NULL;
+    }
+    _common_fixIndex(view.size, &index);
+    return view.data + index * view.stride;
+}
+
+void *emi_dlist_viewReadRaw(DlistView view, ptrdiff_t index) {
+    STATS_CALL_GLOBAL(viewReadRaw);
+    return _emi_dlist_viewReadRaw(view, index);
+}
+
+int emi_dlist_viewReadInto(DlistView view, ptrdiff_t index, void *output) {
+    /* 0 is returned in case of success, 1 in case of failure */
+    STATS_CALL_GLOBAL(viewReadInto);
+    char *element = _emi_dlist_viewReadRaw(view, index);
+    if(element == NULL) return 1;
+    memcpy(output, element, view.data_size);
+    return 0;
+}
+
+ptrdiff_t emi_dlist_viewFind(DlistView view, void *data) {
+    STATS_CALL_GLOBAL(viewFind);
+    return _emi_dlist_viewFind(view, data);
+}
+
+ptrdiff_t emi_dlist_viewCount(DlistView view, void *data) {
+    STATS_CALL_GLOBAL(viewCount);
+    return _emi_dlist_viewCount(view, data);
+}
+
+ptrdiff_t emi_dlist_viewFindByCondition(DlistView view, bool(*condition)(void*)) {
+    STATS_CALL_GLOBAL(viewFindByCondition);
+    return _emi_dlist_viewFindByCondition(view, condition);
+}
+
+Dlist *emi_dlist_viewFindAll(DlistView view, void *data) {
+    STATS_CALL_GLOBAL(viewFindAll);
+    return _emi_dlist_viewFindAll(view, data);
+}
+
+Dlist *emi_dlist_viewFindAllByCondition(DlistView view, bool(*condition)(void*)) {
+    STATS_CALL_GLOBAL(viewFindAllByCondition);
+    return _emi_dlist_viewFindAllByCondition(view, condition);
+}
+
+ptrdiff_t emi_dlist_viewLowerBound(DlistView view, void *data, int(*order)(void*, void*)) {
+    STATS_CALL_GLOBAL(viewLowerBound);
+    return _emi_dlist_viewLowerBound(view, data, order);
+}
+
+ptrdiff_t emi_dlist_viewUpperBound(DlistView view, void *data, int(*order)(void*, void*)) {
+    STATS_CALL_GLOBAL(viewUpperBound);
+    return _emi_dlist_viewUpperBound(view, data, order);
+}
+
+ptrdiff_t emi_dlist_viewBinarySearch(DlistView view, void *data, int(*order)(void*, void*)) {
+    STATS_CALL_GLOBAL(viewBinarySearch);
+    return _emi_dlist_viewBinarySearch(view, data, order);
+}
+
+Dlist *emi_dlist_viewUniqueElements(DlistView view) {
+    STATS_CALL_GLOBAL(viewUniqueElements);
+    Dlist *new_dlist = _emi_dlist_createFromView(view);
+    if(new_dlist != NULL) _emi_dlist_removeDuplicates(new_dlist);
+    return new_dlist;
+}
+
+Dlist *emi_dlist_viewIntersection(DlistView view_one, DlistView view_two) {
+    STATS_CALL_GLOBAL(viewIntersection);
+    return _emi_dlist_viewIntersection(view_one, view_two, DEFAULT_GROWTH_EXPONENTIAL);
+}
+
+Dlist *emi_dlist_viewUnion(DlistView view_one, DlistView view_two) {
+    STATS_CALL_GLOBAL(viewUnion);
+    Dlist *output = _emi_dlist_createFromView(view_one);
+    if(output == NULL) return NULL;
+    _emi_dlist_appendView(output, view_two);
+    _emi_dlist_removeDuplicates(output);
+    return output;
+}
+
+void emi_dlist_viewReduce(DlistView view, void(*map)(void*, void*), void *output) {
+    STATS_CALL_GLOBAL(viewReduce);
+    _emi_dlist_viewReduce(view, map, output);
+    return;
+}
 
+void emi_dlist_viewPrint(DlistView view) {
+    STATS_CALL_GLOBAL(viewPrint);
+    _emi_dlist_viewPrint(view);
     return;
 }
 
@@ -624,13 +2209,16 @@ void emi_dlist_reduce(Dlist *dlist, void(*map)(void*, void*), void *output) {
 
 
 // /*--------------- METADATA FUNCTIONS ---------------*/
-int emi_dlist_size(Dlist *dlist) {
+ptrdiff_t emi_dlist_size(Dlist *dlist) {
+    STATS_CALL(dlist, size);
     return dlist->size; /* x3 */
 }
 int emi_dlist_dataSize(Dlist *dlist) {
+    STATS_CALL(dlist, dataSize);
     return dlist->data_size;
 }
 bool emi_dlist_isEmpty(Dlist *dlist) {
+    STATS_CALL(dlist, isEmpty);
     return dlist->size == 0;
 }
 
@@ -638,15 +2226,66 @@ bool emi_dlist_isEmpty(Dlist *dlist) {
 
 // /*--------------- CLEANING FUNCTIONS ---------------*/
 void emi_dlist_clear(Dlist *dlist) {
+    STATS_CALL(dlist, clear);
     dlist->size = 0;
+    _emi_dlist_autoShrink(dlist);
     return;
     /* heh~ */
 }
 
 void emi_dlist_free(Dlist *dlist) {
-    free(dlist->data);
-    free(dlist);
+    STATS_CALL(dlist, free);
+    _emi_dlist_free(dlist);
+    return;
+}
+
+int emi_dlist_reserve(Dlist *dlist, ptrdiff_t capacity) {
+    /* makes sure capacity elements fit without growing again. It never
+    shrinks, use emi_dlist_shrinkToFit for that.
+    0 is returned in case of success, 1 in case of failure */
+    STATS_CALL(dlist, reserve);
+    if(capacity <= dlist->max_size) return 0;
+    if(_emi_dlist_setCapacity(dlist, capacity) == 1) {
+        printf("can't reserve room for %td elements :(\n", capacity);
+        return 1;
+    }
+    return 0;
+}
+
+int emi_dlist_shrinkToFit(Dlist *dlist) {
+    /* 0 is returned in case of success, 1 in case of failure */
+    STATS_CALL(dlist, shrinkToFit);
+    ptrdiff_t goal_size = dlist->size > 0 ? dlist->size : 1;
+    if(goal_size == dlist->max_size) return 0;
+    return _emi_dlist_shrink(dlist, goal_size);
+}
+
+void emi_dlist_setAutoShrink(Dlist *dlist, bool auto_shrink) {
+    STATS_CALL(dlist, setAutoShrink);
+    dlist->auto_shrink = auto_shrink;
+    _emi_dlist_autoShrink(dlist);
     return;
 }
 
 
+
+
+/*--------------- STATS FUNCTIONS ---------------*/
+void emi_dlist_stats(Dlist *dlist, EmiStats *output) {
+    /* the stats are not counted for this one, so looking doesn't change them */
+    if(dlist == NULL) {
+        _common_statsCopy(&_emi_dlist_global_stats, output);
+    } else {
+        _common_statsCopy(dlist->stats, output);
+    }
+    return;
+}
+
+void emi_dlist_dumpStats(Dlist *dlist) {
+    if(dlist == NULL) {
+        _common_statsPrint(&_emi_dlist_global_stats, "every dlist", _emi_dlist_function_names, DLIST_CALL_COUNT);
+    } else {
+        _common_statsPrint(dlist->stats, "dlist", _emi_dlist_function_names, DLIST_CALL_COUNT);
+    }
+    return;
+}
@@ -19,95 +19,292 @@ by Emika
 
 #include <stdbool.h>
 #include "common.h"
+#include "pool.h"
 
 
 /*--------------- DEFINES ---------------*/
 #define DEFAULT_INITIAL_SIZE 16
 #define DEFAULT_GROWTH_EXPONENTIAL 2.0
+#define RADIX_SORT_THRESHOLD 256 /* int dlists at least this long get radix sorted by the default sorts */
+#define PARALLEL_SORT_MIN_CHUNK 8192 /* parallelSort doesn't give a thread less than this many elements */
+#define SMALL_DUPLICATES 16 /* removeDuplicates only uses a hash set above this size */
+#define BLOCK_SIZE 1024 /* how many elements the block functions give the callback at once */
+#define MAPPED_CREATE   1 /* flags for emi_dlist_openMapped: make the file if it doesn't exist */
+#define MAPPED_TRUNCATE 2 /* throw away what's in the file */
+#define MAPPED_READONLY 4 /* the dlist can't be changed then, and can't grow */
+#define SMALL_BUFFER_BYTES 128 /* dlists that start with at most this much room keep it inside the struct, 0 turns that off */
+#define DEFAULT_HUGE_THRESHOLD ((size_t) 64 << 20) /* a sensible threshold for emi_dlist_createHuge, in bytes */
 
 
 /*--------------- STRUCTS ---------------*/
+struct _EmiDlistShared; /* data that copy-on-write dlists share, see dlist.c */
+
 typedef struct Dlist {
     int data_size;
     int data_type;
-    int size;
-    int max_size;
+    ptrdiff_t size;
+    ptrdiff_t max_size;
     float growth_exponential;
+    bool auto_shrink; /* off unless turned on with emi_dlist_setAutoShrink */
     char *data;
+    EmiStats *stats; /* NULL unless compiled with EMI_STATS */
+    int fd;    /* the file the data is mapped from, or -1 */
+    int flags; /* the flags it was mapped with */
+    size_t huge_threshold; /* bytes above which the data moves to huge pages, 0 for never */
+    bool huge; /* the data is an anonymous mapping instead of malloc'd */
+    EmiAllocator *allocator; /* where the struct and the data come from, NULL for malloc */
+    bool copy_on_write; /* copies and sublists share the data, see emi_dlist_setCopyOnWrite */
+    struct _EmiDlistShared *shared; /* NULL unless the data is shared with other dlists */
+    int inline_bytes; /* how much fits in inline_data */
+    _Alignas(max_align_t) char inline_data[]; /* where the data is while it's small enough */
 } Dlist;
 
+/* a window into elements that live somewhere else, usually in a dlist.
+It's passed by value, and it doesn't own anything, so there's nothing to
+free. It's only valid until the dlist it looks into grows, shrinks or
+is freed */
+typedef struct DlistView {
+    char *data;       /* the first element */
+    ptrdiff_t size;   /* how many elements */
+    ptrdiff_t stride; /* bytes from one element to the next, data_size unless it skips some */
+    int data_size;
+    int data_type;
+} DlistView;
+
 /*--------------- ENUMS ---------------*/
+/* every function has a number, which is where it's counted in the stats */
+#define EMI_DLIST_FUNCTIONS(X)                                                                         \
+    X(create) X(createWithParas) X(createFromArray) X(createCopy) X(createSublist) X(createSplit)      \
+    X(openMapped) X(sync) X(close) X(save) X(load) X(loadChunked)                                      \
+    X(read) X(readInto) X(readRaw) X(append) X(prepend) X(insert)                                      \
+    X(insertRange) X(remove) X(removeRange) X(pop) X(popInto) X(set)                                   \
+    X(swap) X(extendByArray) X(extendByDlist) X(randomizeOrder) X(betterSort) X(betterSortByOrder)     \
+    X(stableSort) X(stableSortByOrder) X(radixSort) X(parallelSort) X(bubbleSort) X(bubbleSortByOrder) \
+    X(reverse) X(filter) X(filterBlock) X(removeDuplicates) X(print) X(printString)                    \
+    X(sprintString) X(find) X(count) X(findByCondition) X(findAll) X(findAllByCondition)               \
+    X(lowerBound) X(upperBound) X(binarySearch) X(insertSorted) X(mergeSorted) X(createEytzinger)      \
+    X(eytzingerLowerBound) X(eytzingerSearch) X(uniqueElements) X(intersection) X(union) X(map)        \
+    X(mapBlock) X(reduce) X(reduceBlock) X(parallelMap) X(parallelReduce) X(size)                      \
+    X(dataSize) X(isEmpty) X(clear) X(free) X(reserve) X(shrinkToFit)                                  \
+    X(setAutoShrink) X(createHuge) X(createWithAllocator) X(createFromView) X(setCopyOnWrite)          \
+    X(extendByView) X(view) X(viewRange) X(viewSlice) X(viewFromArray) X(viewReadRaw) X(viewReadInto)  \
+    X(viewFind) X(viewCount) X(viewFindByCondition) X(viewFindAll) X(viewFindAllByCondition)           \
+    X(viewLowerBound) X(viewUpperBound) X(viewBinarySearch) X(viewUniqueElements) X(viewIntersection)  \
+    X(viewUnion) X(viewReduce) X(viewPrint)
+
+#define _EMI_DLIST_CALL(name) DLIST_CALL_##name,
+typedef enum {
+    EMI_DLIST_FUNCTIONS(_EMI_DLIST_CALL)
+    DLIST_CALL_COUNT
+} DlistCall;
 
 
 
 
 /*--------------- CREATION FUNCTIONS ---------------*/
 Dlist *emi_dlist_create          (int data_size, int data_type);
-Dlist *emi_dlist_createWithParas (int data_size, int data_type, int initial_size, float growth_exponential);
-Dlist *emi_dlist_createFromArray (void *data, int array_length, int data_size, int data_type);
-Dlist *emi_dlist_createCopy      (Dlist *original);
-Dlist *emi_dlist_createSublist   (Dlist *original, int start_index, int end_index);
-Dlist *emi_dlist_createSplit     (Dlist *original, int index); /* shortens the inputed dlist, and returns the second half */
+Dlist *emi_dlist_createWithParas (int data_size, int data_type, ptrdiff_t initial_size, float growth_exponential);
+Dlist *emi_dlist_createFromArray (void *data, ptrdiff_t array_length, int data_size, int data_type);
+Dlist *emi_dlist_createCopy      (Dlist *original); /* O(1) for copy-on-write dlists */
+Dlist *emi_dlist_createSublist   (Dlist *original, ptrdiff_t start_index, ptrdiff_t end_index); /* same here */
+Dlist *emi_dlist_createFromView  (DlistView view); /* always copies */
+Dlist *emi_dlist_createSplit     (Dlist *original, ptrdiff_t index); /* shortens the inputed dlist, and returns the second half */
+Dlist *emi_dlist_createWithAllocator (int data_size, int data_type, ptrdiff_t initial_size, float growth_exponential, EmiAllocator *allocator); /* copies get the same allocator, see alloc.h */
+/* createHuge makes a dlist that, once its data gets bigger than huge_threshold
+bytes, keeps it in an anonymous mapping with huge pages instead. Growing that
+just remaps the pages instead of copying them, which is a lot faster for
+dlists of hundreds of MB. It stays mapped even if it shrinks again */
+Dlist *emi_dlist_createHuge      (int data_size, int data_type, ptrdiff_t initial_size, float growth_exponential, size_t huge_threshold);
+
+/*--------------- COPY-ON-WRITE FUNCTIONS ---------------*/
+/* once it's turned on, createCopy, createSublist and createSplit don't copy
+the data of the dlist, they share it, and so do copies of those copies.
+The first time any of them is changed, that one gets its own copy. It's
+not for mapped or huge dlists, those still get copied. Don't write through
+readRaw or a typed view of a dlist that's shared, the others would see it */
+void   emi_dlist_setCopyOnWrite  (Dlist *dlist, bool copy_on_write);
+
+/*--------------- MAPPED FUNCTIONS ---------------*/
+/* a dlist whose data is a file, mapped into memory. Only the parts that
+are used are read from the disk, and other processes mapping the same
+file share its pages. Growing makes the file bigger. The header of the
+file has the size in it, which is updated by sync, close and free */
+Dlist *emi_dlist_openMapped      (char *path, int data_size, int data_type, int flags);
+int    emi_dlist_sync            (Dlist *dlist); /* writes everything to the disk, returns 1 on failure */
+void   emi_dlist_close           (Dlist *dlist); /* syncs and frees, and any dlist can be closed */
+
+/*--------------- SAVING FUNCTIONS ---------------*/
+/* the files have the same header as mapped ones, so they can be opened
+mapped as well */
+int    emi_dlist_save            (Dlist *dlist, FILE *file); /* returns 1 on failure */
+Dlist *emi_dlist_load            (FILE *file); /* the element size and type come from the file */
+int    emi_dlist_loadChunked     (Dlist *dlist, FILE *file, ptrdiff_t chunk_size); /* appends chunk_size elements at a time, returns 1 on failure */
 
 /*--------------- READING FUNCTIONS ---------------*/
-void  *emi_dlist_read    (Dlist *dlist,             int index);
-void  *emi_dlist_readRaw (Dlist *dlist,             int index);
+void  *emi_dlist_read     (Dlist *dlist,             ptrdiff_t index);
+void  *emi_dlist_readRaw  (Dlist *dlist,             ptrdiff_t index);
+int    emi_dlist_readInto (Dlist *dlist,             ptrdiff_t index, void *output); /* no malloc, returns 1 on failure */
 
 /*--------------- MODIFICATION FUNCTIONS ---------------*/
-void   emi_dlist_append        (Dlist *dlist, void *data           );
-void   emi_dlist_prepend       (Dlist *dlist, void *data           );
-void   emi_dlist_insert        (Dlist *dlist, void *data, int index);
-void   emi_dlist_remove        (Dlist *dlist,             int index);
-void  *emi_dlist_pop           (Dlist *dlist                       );
-void   emi_dlist_set           (Dlist *dlist, void *data, int index);
-void   emi_dlist_swap          (Dlist *dlist, int index_one, int index_two);
-void   emi_dlist_extendByArray (Dlist *dlist, void *data, int array_length);
+void   emi_dlist_append        (Dlist *dlist, void *data                 );
+void   emi_dlist_prepend       (Dlist *dlist, void *data                 );
+void   emi_dlist_insert        (Dlist *dlist, void *data, ptrdiff_t index);
+void   emi_dlist_insertRange   (Dlist *dlist, void *data, ptrdiff_t count, ptrdiff_t index);
+void   emi_dlist_remove        (Dlist *dlist,             ptrdiff_t index);
+void   emi_dlist_removeRange   (Dlist *dlist, ptrdiff_t start_index, ptrdiff_t end_index); /* end_index itself is kept */
+void  *emi_dlist_pop           (Dlist *dlist                             );
+int    emi_dlist_popInto       (Dlist *dlist, void *output               ); /* no malloc, returns 1 on failure */
+void   emi_dlist_set           (Dlist *dlist, void *data, ptrdiff_t index);
+void   emi_dlist_swap          (Dlist *dlist, ptrdiff_t index_one, ptrdiff_t index_two);
+void   emi_dlist_extendByArray (Dlist *dlist, void *data, ptrdiff_t array_length);
 void   emi_dlist_extendByDlist (Dlist *dlist, Dlist *data);
+void   emi_dlist_extendByView  (Dlist *dlist, DlistView data);
 
 /*--------------- ORDER CHANGING FUNCTIONS ---------------*/
 void   emi_dlist_randomizeOrder       (Dlist *dlist);
-void   emi_dlist_bubbleSort           (Dlist *dlist); /* very shitty */
+void   emi_dlist_betterSort           (Dlist *dlist); /* pdqsort, not stable */
+void   emi_dlist_betterSortByOrder    (Dlist *dlist, int(*order)(void*, void*));
+void   emi_dlist_stableSort           (Dlist *dlist); /* merge sort */
+void   emi_dlist_stableSortByOrder    (Dlist *dlist, int(*order)(void*, void*));
+void   emi_dlist_radixSort            (Dlist *dlist); /* for chars, ints and floats, sorts by the first value */
+void   emi_dlist_parallelSort         (Dlist *dlist, int(*order)(void*, void*), int threads); /* same result as stableSortByOrder */
+void   emi_dlist_bubbleSort           (Dlist *dlist); /* same as the stable sort now, only here for old code */
 void   emi_dlist_bubbleSortByOrder    (Dlist *dlist, int(*order)(void*, void*));
 void   emi_dlist_reverse              (Dlist *dlist);
 
 /*--------------- THINNENING CHANGING FUNCTIONS ---------------*/
 void   emi_dlist_filter               (Dlist *dlist, bool(*condition)(void*));
+void   emi_dlist_filterBlock          (Dlist *dlist, void(*condition)(void*, bool*, int)); /* condition(in, keep, count) fills a keep mask per block */
 void   emi_dlist_removeDuplicates     (Dlist *dlist);
 
 /*--------------- SEARCHING FUNCTIONS ---------------*/
-int    emi_dlist_find                 (Dlist *dlist, void *data);
-int    emi_dlist_findByCondition      (Dlist *dlist, bool(*condition)(void*));
-Dlist *emi_dlist_findAll              (Dlist *dlist, void *data);
-Dlist *emi_dlist_findAllByCondition   (Dlist *dlist, bool(*condition)(void*));
+ptrdiff_t  emi_dlist_find                 (Dlist *dlist, void *data);
+ptrdiff_t  emi_dlist_count                (Dlist *dlist, void *data);
+ptrdiff_t  emi_dlist_findByCondition      (Dlist *dlist, bool(*condition)(void*));
+Dlist     *emi_dlist_findAll              (Dlist *dlist, void *data); /* a dlist of ptrdiff_t indices */
+Dlist     *emi_dlist_findAllByCondition   (Dlist *dlist, bool(*condition)(void*));
+
+/*--------------- SORTED FUNCTIONS ---------------*/
+/* for dlists sorted by order, NULL means the default order */
+ptrdiff_t  emi_dlist_lowerBound           (Dlist *dlist, void *data, int(*order)(void*, void*));
+ptrdiff_t  emi_dlist_upperBound           (Dlist *dlist, void *data, int(*order)(void*, void*));
+ptrdiff_t  emi_dlist_binarySearch         (Dlist *dlist, void *data, int(*order)(void*, void*));
+void       emi_dlist_insertSorted         (Dlist *dlist, void *data, int(*order)(void*, void*));
+Dlist     *emi_dlist_mergeSorted          (Dlist *dlist_one, Dlist *dlist_two, int(*order)(void*, void*));
+Dlist     *emi_dlist_createEytzinger      (Dlist *sorted); /* a copy laid out for faster searching */
+ptrdiff_t  emi_dlist_eytzingerLowerBound  (Dlist *eytzinger, void *data, int(*order)(void*, void*));
+ptrdiff_t  emi_dlist_eytzingerSearch      (Dlist *eytzinger, void *data, int(*order)(void*, void*));
 
 /*--------------- SET OPERATIONS ---------------*/
-Dlist *emi_dlist_uniqueElements       (Dlist *dlist);
-Dlist *emi_dlist_intersection         (Dlist *dlist_one, Dlist *dlist_two); /* not made yet */
-Dlist *emi_dlist_union                (Dlist *dlist_one, Dlist *dlist_two);
+Dlist     *emi_dlist_uniqueElements       (Dlist *dlist);
+Dlist     *emi_dlist_intersection         (Dlist *dlist_one, Dlist *dlist_two);
+Dlist     *emi_dlist_union                (Dlist *dlist_one, Dlist *dlist_two);
 
 /*--------------- COMPUTATIONAL FUNCTIONS ---------------*/
-void emi_dlist_map     (Dlist *dlist, void(*map)(void*, void*));
-void emi_dlist_reduce  (Dlist *dlist, void(*map)(void*, void*), void* output);
+void emi_dlist_map            (Dlist *dlist, void(*map)(void*, void*));
+void emi_dlist_mapBlock       (Dlist *dlist, void(*map)(void*, void*, int)); /* map(in, out, count) on blocks of BLOCK_SIZE elements */
+void emi_dlist_reduce         (Dlist *dlist, void(*map)(void*, void*), void* output);
+void emi_dlist_reduceBlock    (Dlist *dlist, void(*reduce)(void*, int, void*), void* output); /* reduce(in, count, output) */
+void emi_dlist_parallelMap    (Dlist *dlist, void(*map)(void*, void*), Pool *pool);
+void emi_dlist_parallelReduce (Dlist *dlist, void(*map)(void*, void*), void(*combine)(void*, void*), void *identity, void *output, int output_size, Pool *pool);
+
+/*--------------- VIEW FUNCTIONS ---------------*/
+/* the same as the dlist functions with the same name, but on a view, so
+nothing gets copied. The ones that give a dlist give a new one, and the
+indices are indices in the view */
+DlistView  emi_dlist_view                 (Dlist *dlist);
+DlistView  emi_dlist_viewRange            (Dlist *dlist, ptrdiff_t start_index, ptrdiff_t end_index); /* indices like createSublist */
+DlistView  emi_dlist_viewSlice            (DlistView view, ptrdiff_t start_index, ptrdiff_t end_index, ptrdiff_t step); /* every step-th element */
+DlistView  emi_dlist_viewFromArray        (void *data, ptrdiff_t array_length, int data_size, int data_type);
+void      *emi_dlist_viewReadRaw          (DlistView view, ptrdiff_t index);
+int        emi_dlist_viewReadInto         (DlistView view, ptrdiff_t index, void *output); /* returns 1 on failure */
+ptrdiff_t  emi_dlist_viewFind             (DlistView view, void *data);
+ptrdiff_t  emi_dlist_viewCount            (DlistView view, void *data);
+ptrdiff_t  emi_dlist_viewFindByCondition  (DlistView view, bool(*condition)(void*));
+Dlist     *emi_dlist_viewFindAll          (DlistView view, void *data);
+Dlist     *emi_dlist_viewFindAllByCondition (DlistView view, bool(*condition)(void*));
+ptrdiff_t  emi_dlist_viewLowerBound       (DlistView view, void *data, int(*order)(void*, void*));
+ptrdiff_t  emi_dlist_viewUpperBound       (DlistView view, void *data, int(*order)(void*, void*));
+ptrdiff_t  emi_dlist_viewBinarySearch     (DlistView view, void *data, int(*order)(void*, void*));
+Dlist     *emi_dlist_viewUniqueElements   (DlistView view);
+Dlist     *emi_dlist_viewIntersection     (DlistView view_one, DlistView view_two);
+Dlist     *emi_dlist_viewUnion            (DlistView view_one, DlistView view_two);
+void       emi_dlist_viewReduce           (DlistView view, void(*map)(void*, void*), void *output);
+void       emi_dlist_viewPrint            (DlistView view);
 
 /*--------------- UTILITY FUNCTIONS ---------------*/
-int emi_dlist_size     (Dlist *dlist);
+ptrdiff_t emi_dlist_size (Dlist *dlist);
 int emi_dlist_dataSize (Dlist *dlist);
 void emi_dlist_print        (Dlist *dlist);
 void emi_dlist_printString  (Dlist *dlist);
 void emi_dlist_sprintString (char *buffer, Dlist *dlist);
 
 /*--------------- MEMORY MANAGEMENT FUNCTIONS ---------------*/
-void emi_dlist_clear   (Dlist *dlist);
-void emi_dlist_free    (Dlist *dlist);
-bool emi_dlist_isEmpty (Dlist *dlist);
+void emi_dlist_clear         (Dlist *dlist);
+void emi_dlist_free          (Dlist *dlist);
+bool emi_dlist_isEmpty       (Dlist *dlist);
+int  emi_dlist_reserve       (Dlist *dlist, ptrdiff_t capacity); /* makes room for at least capacity elements */
+int  emi_dlist_shrinkToFit   (Dlist *dlist); /* gives back everything that isn't used */
+void emi_dlist_setAutoShrink (Dlist *dlist, bool auto_shrink); /* shrink when size drops below max_size / growth² */
 
-/*--------------- FUNCTIONS TO ADD ---------------*/
-/*
-void  emi_dlist_betterSort           (Dlist *dlist);
-void  emi_dlist_betterSortByOrder    (Dlist *dlist, int(*order)(void*, void*));
-int   emi_dlist_count                (Dlist *dlist, void *data);
+/*--------------- STATS FUNCTIONS ---------------*/
+void emi_dlist_stats     (Dlist *dlist, EmiStats *output); /* a NULL dlist gives the totals of every dlist */
+void emi_dlist_dumpStats (Dlist *dlist); /* same here */
+
+/*--------------- INTERNAL FUNCTIONS ---------------*/
+int  _emi_dlist_grow   (Dlist *dlist, ptrdiff_t goal_size); /* only here for the typed dlists */
+int  _emi_dlist_own    (Dlist *dlist); /* same, gives a shared dlist its own data */
 
 
+
+/*--------------- TYPED DLISTS ---------------*/
+/* EMI_DLIST_DEFINE(ints, int) makes static inline functions like
+ints_append(Dlist*, int) and ints_get(Dlist*, ptrdiff_t index), which work
+on a completely normal Dlist of ints, but know the type, so the 
+compiler can inline them and doesn't need a memcpy of data_size bytes.
+ints_view(dlist) gives the data as an int*, or NULL if the dlist
+doesn't hold elements of that size. Don't write through it when the
+dlist is copy-on-write. Apart from negative indices,
+nothing gets checked, so don't get from an empty dlist */
+#define EMI_DLIST_DEFINE(name, T)                                                   \
+static inline Dlist *name##_create(int data_type) {                                 \
+    return emi_dlist_create(sizeof(T), data_type);                                  \
+}                                                                                   \
+static inline T *name##_view(Dlist *dlist) {                                        \
+    if(dlist->data_size != (int) sizeof(T)) return NULL;                            \
+    return (T*) dlist->data;                                                        \
+}                                                                                   \
+static inline ptrdiff_t name##_size(Dlist *dlist) {                                 \
+    return dlist->size;                                                             \
+}                                                                                   \
+static inline void name##_append(Dlist *dlist, T value) {                           \
+    if(dlist->size == dlist->max_size && _emi_dlist_grow(dlist, dlist->size + 1) == 1) \
+        return;                                                                     \
+    if((dlist->shared != NULL || (dlist->flags & MAPPED_READONLY))                  \
+       && _emi_dlist_own(dlist) == 1)                                               \
+        return;                                                                     \
+    ((T*) dlist->data)[dlist->size++] = value;                                      \
+}                                                                                   \
+static inline T name##_pop(Dlist *dlist) { /* doesn't auto shrink */                \
+    return ((T*) dlist->data)[--dlist->size];                                       \
+}                                                                                   \
+static inline T name##_get(Dlist *dlist, ptrdiff_t index) {                         \
+    if(index < 0) index += dlist->size;                                             \
+    return ((T*) dlist->data)[index];                                               \
+}                                                                                   \
+static inline void name##_set(Dlist *dlist, ptrdiff_t index, T value) {             \
+    if(index < 0) index += dlist->size;                                             \
+    if((dlist->shared != NULL || (dlist->flags & MAPPED_READONLY))                  \
+       && _emi_dlist_own(dlist) == 1)                                               \
+        return;                                                                     \
+    ((T*) dlist->data)[index] = value;                                              \
+}                                                                                   \
+static inline void name##_sort(Dlist *dlist, int(*order)(void*, void*)) {           \
+    emi_dlist_betterSortByOrder(dlist, order);                                      \
+}
+
+/*--------------- FUNCTIONS TO ADD ---------------*/
+/*
     this one could be in a library that binds them all together
 void  emi_dlist_extendByList         (Dlist *dlist, List *data);
 
@@ -0,0 +1,369 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "dmap.h"
+#include "common.h"
+
+
+/* a control byte is either empty, deleted (a tombstone), or it holds
+the lowest 7 bits of the hash of the key in the slot */
+#define CONTROL_EMPTY   0x80
+#define CONTROL_DELETED 0xfe
+#define CONTROL_FULL(control) ((control) < 0x80)
+
+
+/*--------------- INTERNAL FUNCTIONS ---------------*/
+int _emi_dmap_alignment(int size) {
+    /* the largest power of two (up to 8) which divides the size */
+    int alignment = 1;
+    while(alignment < 8 && size % (alignment * 2) == 0) alignment *= 2;
+    return alignment;
+}
+
+int _emi_dmap_capacityFor(int size) {
+    /* we keep the map at most 7/8 full */
+    long capacity = DMAP_GROUP_SIZE;
+    while(capacity * 7 / 8 < size) capacity *= 2;
+    return capacity;
+}
+
+char *_emi_dmap_slot(Dmap *dmap, long index) {
+    return dmap->data + index * dmap->slot_size;
+}
+
+
+uint32_t _emi_dmap_matchByte(unsigned char *group, unsigned char byte) {
+    /* returns a bitmask of the control bytes in the group equal to byte */
+#ifdef __SSE2__
+    __m128i controls = _mm_load_si128((__m128i*) group);
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(controls, _mm_set1_epi8((char) byte)));
+#else
+    uint32_t mask = 0;
+    for(int i=0; i<DMAP_GROUP_SIZE; i++)
+        mask |= (uint32_t) (group[i] == byte) << i;
+    return mask;
+#endif
+}
+
+uint32_t _emi_dmap_matchFree(unsigned char *group) {
+    /* bitmask of the empty and deleted slots, those are exactly the
+    control bytes with the highest bit set */
+#ifdef __SSE2__
+    return _mm_movemask_epi8(_mm_load_si128((__m128i*) group));
+#else
+    uint32_t mask = 0;
+    for(int i=0; i<DMAP_GROUP_SIZE; i++)
+        mask |= (uint32_t) (group[i] >> 7) << i;
+    return mask;
+#endif
+}
+
+int _emi_dmap_lowestBit(uint32_t mask) {
+    return __builtin_ctz(mask);
+}
+
+
+long _emi_dmap_find(Dmap *dmap, void *key, uint64_t hash) {
+    /* returns the index of the slot with the key, or -1 */
+    long group_mask = dmap->max_size / DMAP_GROUP_SIZE - 1;
+    long group      = (hash >> 7) & group_mask;
+    unsigned char fingerprint = hash & 0x7f;
+
+    for(long probe=1; ; probe++) {
+        unsigned char *controls = dmap->control + group * DMAP_GROUP_SIZE;
+
+        uint32_t matches = _emi_dmap_matchByte(controls, fingerprint);
+        while(matches != 0) {
+            long index = group * DMAP_GROUP_SIZE + _emi_dmap_lowestBit(matches);
+            if(memcmp(_emi_dmap_slot(dmap, index), key, dmap->key_size) == 0)
+                return index;
+            matches &= matches - 1;
+        }
+
+        /* if there's an empty slot in this group, the key would have been put here */
+        if(_emi_dmap_matchByte(controls, CONTROL_EMPTY) != 0)
+            return -1;
+        if(probe > group_mask) /* every group has been checked (only with lots of tombstones) */
+            return -1;
+
+        /* triangular probing, which visits every group once when the amount is a power of two */
+        group = (group + probe) & group_mask;
+    }
+}
+
+long _emi_dmap_findFree(Dmap *dmap, uint64_t hash) {
+    /* returns the first empty or deleted slot on the probe sequence of hash.
+    There is always one, since we never let the map get completely full */
+    long group_mask = dmap->max_size / DMAP_GROUP_SIZE - 1;
+    long group      = (hash >> 7) & group_mask;
+
+    for(long probe=1; ; probe++) {
+        uint32_t free_slots = _emi_dmap_matchFree(dmap->control + group * DMAP_GROUP_SIZE);
+        if(free_slots != 0)
+            return group * DMAP_GROUP_SIZE + _emi_dmap_lowestBit(free_slots);
+        group = (group + probe) & group_mask;
+    }
+}
+
+
+unsigned char *_emi_dmap_allocControl(int max_size) {
+    /* the control bytes are loaded 16 at a time, so they have to be aligned */
+    unsigned char *control = (unsigned char*) aligned_alloc (DMAP_GROUP_SIZE, max_size);
+    if(control != NULL)
+        memset(control, CONTROL_EMPTY, max_size);
+    return control;
+}
+
+int _emi_dmap_rehash(Dmap *dmap, int new_max_size) {
+    /* moves everything into new arrays of new_max_size slots, which also
+    gets rid of all the tombstones.
+    0 is returned in case of success, 1 in case of failure */
+    unsigned char *new_control = _emi_dmap_allocControl(new_max_size);
+    char *new_data = (char*) malloc ((long) new_max_size * dmap->slot_size);
+    if(new_control == NULL || new_data == NULL) {
+        printf("reallocation failed. tried to give %ld bytes\n", (long) new_max_size * (dmap->slot_size + 1));
+        free(new_control);
+        free(new_data);
+        return 1;
+    }
+
+    unsigned char *old_control  = dmap->control;
+    char          *old_data     = dmap->data;
+    int            old_max_size = dmap->max_size;
+
+    dmap->control     = new_control;
+    dmap->data        = new_data;
+    dmap->max_size    = new_max_size;
+    dmap->growth_left = (long) new_max_size * 7 / 8 - dmap->size;
+
+    /* all keys are different, so we don't have to compare anything */
+    for(long i=0; i<old_max_size; i++) {
+        if(!CONTROL_FULL(old_control[i])) continue;
+        char *old_slot = old_data + i * dmap->slot_size;
+        uint64_t hash = _common_hash(old_slot, dmap->key_size, dmap->key_type);
+        long index = _emi_dmap_findFree(dmap, hash);
+        dmap->control[index] = hash & 0x7f;
+        memcpy(_emi_dmap_slot(dmap, index), old_slot, dmap->slot_size);
+    }
+
+    free(old_control);
+    free(old_data);
+    return 0;
+}
+
+
+
+
+/*--------------- CREATION FUNCTIONS ---------------*/
+Dmap *emi_dmap_create(int key_size, int key_type, int value_size, int value_type) {
+    return emi_dmap_createWithParas(key_size, key_type, value_size, value_type, DMAP_DEFAULT_INITIAL_SIZE);
+}
+
+
+Dmap *emi_dmap_createWithParas(int key_size, int key_type, int value_size, int value_type, int initial_size) {
+    Dmap *new_dmap = (Dmap*) malloc (sizeof(Dmap));
+    if(new_dmap == NULL) {
+        printf("malloc failed in emi_dmap_createWithParas :(\n");
+        return NULL;
+    }
+
+    /* the value is aligned inside the slot, so the pointer emi_dmap_get
+    returns can be used directly, and the slots are padded so the next
+    key is aligned as well */
+    int value_alignment = _emi_dmap_alignment(value_size);
+    int slot_alignment  = value_alignment > _emi_dmap_alignment(key_size) ? value_alignment : _emi_dmap_alignment(key_size);
+    int value_offset    = (key_size + value_alignment - 1) / value_alignment * value_alignment;
+    int slot_size       = (value_offset + value_size + slot_alignment - 1) / slot_alignment * slot_alignment;
+    int max_size        = _emi_dmap_capacityFor(initial_size);
+
+    new_dmap->key_size     = key_size;
+    new_dmap->key_type     = key_type;
+    new_dmap->value_size   = value_size;
+    new_dmap->value_type   = value_type;
+    new_dmap->size         = 0;
+    new_dmap->max_size     = max_size;
+    new_dmap->growth_left  = max_size * 7 / 8;
+    new_dmap->value_offset = value_offset;
+    new_dmap->slot_size    = slot_size;
+    new_dmap->control      = _emi_dmap_allocControl(max_size);
+    new_dmap->data         = (char*) malloc ((long) max_size * slot_size);
+
+    if(new_dmap->control == NULL || new_dmap->data == NULL) {
+        printf("malloc failed in emi_dmap_createWithParas :(\n");
+        free(new_dmap->control);
+        free(new_dmap->data);
+        free(new_dmap);
+        return NULL;
+    }
+
+    return new_dmap;
+}
+
+
+Dmap *emi_dmap_createCopy(Dmap *original) {
+    Dmap *new_dmap = emi_dmap_createWithParas(original->key_size, original->key_type, original->value_size, original->value_type, 0);
+    if(new_dmap == NULL) return NULL;
+
+    /* a copy of the arrays keeps all the slots where they are */
+    if(_emi_dmap_rehash(new_dmap, original->max_size) == 1) {
+        emi_dmap_free(new_dmap);
+        return NULL;
+    }
+    memcpy(new_dmap->control, original->control, original->max_size);
+    memcpy(new_dmap->data, original->data, (long) original->max_size * original->slot_size);
+    new_dmap->size        = original->size;
+    new_dmap->growth_left = original->growth_left;
+    return new_dmap;
+}
+
+
+
+
+/*--------------- READING FUNCTIONS ---------------*/
+void *emi_dmap_get(Dmap *dmap, void *key) {
+    long index = _emi_dmap_find(dmap, key, _common_hash(key, dmap->key_size, dmap->key_type));
+    if(index == -1) return NULL;
+    return _emi_dmap_slot(dmap, index) + dmap->value_offset;
+}
+
+bool emi_dmap_contains(Dmap *dmap, void *key) {
+    return _emi_dmap_find(dmap, key, _common_hash(key, dmap->key_size, dmap->key_type)) != -1;
+}
+
+
+
+
+/*--------------- MODIFICATION FUNCTIONS ---------------*/
+void emi_dmap_put(Dmap *dmap, void *key, void *value) {
+    uint64_t hash = _common_hash(key, dmap->key_size, dmap->key_type);
+    long index = _emi_dmap_find(dmap, key, hash);
+    if(index != -1) {
+        memcpy(_emi_dmap_slot(dmap, index) + dmap->value_offset, value, dmap->value_size);
+        return;
+    }
+
+    if(dmap->growth_left == 0) {
+        /* if most of the used up room is tombstones, rehashing
+        in place is enough, otherwise we grow */
+        int new_max_size = dmap->max_size;
+        if(dmap->size >= (long) dmap->max_size * 7 / 16)
+            new_max_size *= 2;
+        if(_emi_dmap_rehash(dmap, new_max_size) == 1) {
+            printf("can't put :(\n");
+            return;
+        }
+    }
+
+    index = _emi_dmap_findFree(dmap, hash);
+    if(dmap->control[index] == CONTROL_EMPTY) /* reusing a tombstone doesn't use up more room */
+        dmap->growth_left--;
+    dmap->control[index] = hash & 0x7f;
+
+    char *slot = _emi_dmap_slot(dmap, index);
+    memcpy(slot, key, dmap->key_size);
+    memcpy(slot + dmap->value_offset, value, dmap->value_size);
+    dmap->size++;
+    return;
+}
+
+void emi_dmap_remove(Dmap *dmap, void *key) {
+    long index = _emi_dmap_find(dmap, key, _common_hash(key, dmap->key_size, dmap->key_type));
+    if(index == -1) return;
+
+    /* if the group still has an empty slot, every search stops in this
+    group anyway, so this slot can be empty again instead of a tombstone */
+    unsigned char *controls = dmap->control + index / DMAP_GROUP_SIZE * DMAP_GROUP_SIZE;
+    if(_emi_dmap_matchByte(controls, CONTROL_EMPTY) != 0) {
+        dmap->control[index] = CONTROL_EMPTY;
+        dmap->growth_left++;
+    } else {
+        dmap->control[index] = CONTROL_DELETED;
+    }
+    dmap->size--;
+    return;
+}
+
+void emi_dmap_reserve(Dmap *dmap, int size) {
+    /* makes sure size entries fit without having to grow */
+    int new_max_size = _emi_dmap_capacityFor(size);
+    if(new_max_size <= dmap->max_size) return;
+    if(_emi_dmap_rehash(dmap, new_max_size) == 1)
+        printf("can't reserve :(\n");
+    return;
+}
+
+
+
+
+/*--------------- ITERATING FUNCTIONS ---------------*/
+int emi_dmap_next(Dmap *dmap, int iterator, void **key, void **value) {
+    /* goes through the slots in memory order, so:
+    for(int i = emi_dmap_next(map, -1, &key, &value); i != -1; i = emi_dmap_next(map, i, &key, &value))
+    key and value can be NULL if you don't need them. Don't put
+    anything in the map while iterating, removing is fine though */
+    for(long i=iterator+1; i<dmap->max_size; i++) {
+        if(!CONTROL_FULL(dmap->control[i])) continue;
+        char *slot = _emi_dmap_slot(dmap, i);
+        if(key   != NULL) *key   = slot;
+        if(value != NULL) *value = slot + dmap->value_offset;
+        return i;
+    }
+    return -1;
+}
+
+
+
+
+// /*--------------- METADATA FUNCTIONS ---------------*/
+int emi_dmap_size(Dmap *dmap) {
+    return dmap->size;
+}
+
+bool emi_dmap_isEmpty(Dmap *dmap) {
+    return dmap->size == 0;
+}
+
+
+void emi_dmap_print(Dmap *dmap) {
+    if(dmap->key_type == DATA_TYPE_DEF || dmap->value_type == DATA_TYPE_DEF) {
+        printf("can't print default data type\n");
+        return;
+    }
+
+    void *key, *value;
+    bool first = true;
+    printf("{");
+    for(int i = emi_dmap_next(dmap, -1, &key, &value); i != -1; i = emi_dmap_next(dmap, i, &key, &value)) {
+        if(!first) printf(", ");
+        _common_printData(key, dmap->key_size, dmap->key_type);
+        printf(": ");
+        _common_printData(value, dmap->value_size, dmap->value_type);
+        first = false;
+    }
+    printf("}\n");
+    return;
+}
+
+
+
+// /*--------------- CLEANING FUNCTIONS ---------------*/
+void emi_dmap_clear(Dmap *dmap) {
+    memset(dmap->control, CONTROL_EMPTY, dmap->max_size);
+    dmap->size        = 0;
+    dmap->growth_left = dmap->max_size * 7 / 8;
+    return;
+}
+
+void emi_dmap_free(Dmap *dmap) {
+    free(dmap->control);
+    free(dmap->data);
+    free(dmap);
+    return;
+}
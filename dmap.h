@@ -0,0 +1,79 @@
+/* hash map library, the keys and values work
+just like the elements of a dlist
+
+  ____
+ /    \
+| _  _ |
+|      |
+ \    /
+  \  /
+   \/
+
+
+
+the layout is the one of google's swiss tables: one control byte per
+slot, and the slots are looked at in groups of 16 at a time
+*/
+
+
+
+#ifndef DMAP_H
+#define DMAP_H
+
+
+#include <stdbool.h>
+#include "common.h"
+
+
+/*--------------- DEFINES ---------------*/
+#define DMAP_DEFAULT_INITIAL_SIZE 16
+#define DMAP_GROUP_SIZE 16 /* the amount of control bytes that get compared at once */
+
+
+/*--------------- STRUCTS ---------------*/
+typedef struct Dmap {
+    int key_size;
+    int key_type;
+    int value_size;
+    int value_type;
+    int size;          /* the amount of entries */
+    int max_size;      /* the amount of slots, always a power of two and at least a group */
+    int growth_left;   /* entries we can add before we have to rehash */
+    int value_offset;  /* where the value starts in a slot */
+    int slot_size;
+    unsigned char *control;
+    char *data;
+} Dmap;
+
+/*--------------- ENUMS ---------------*/
+
+
+
+
+/*--------------- CREATION FUNCTIONS ---------------*/
+Dmap *emi_dmap_create          (int key_size, int key_type, int value_size, int value_type);
+Dmap *emi_dmap_createWithParas (int key_size, int key_type, int value_size, int value_type, int initial_size);
+Dmap *emi_dmap_createCopy      (Dmap *original);
+
+/*--------------- READING FUNCTIONS ---------------*/
+void *emi_dmap_get      (Dmap *dmap, void *key); /* pointer to the value in the map, or NULL */
+bool  emi_dmap_contains (Dmap *dmap, void *key);
+
+/*--------------- MODIFICATION FUNCTIONS ---------------*/
+void  emi_dmap_put      (Dmap *dmap, void *key, void *value); /* overwrites the value if the key is already in there */
+void  emi_dmap_remove   (Dmap *dmap, void *key);
+void  emi_dmap_reserve  (Dmap *dmap, int size);
+
+/*--------------- ITERATING FUNCTIONS ---------------*/
+int   emi_dmap_next     (Dmap *dmap, int iterator, void **key, void **value); /* start with -1, returns -1 at the end */
+
+/*--------------- UTILITY FUNCTIONS ---------------*/
+int   emi_dmap_size     (Dmap *dmap);
+bool  emi_dmap_isEmpty  (Dmap *dmap);
+void  emi_dmap_print    (Dmap *dmap);
+
+/*--------------- MEMORY MANAGEMENT FUNCTIONS ---------------*/
+void  emi_dmap_clear    (Dmap *dmap);
+void  emi_dmap_free     (Dmap *dmap);
+
+#endif
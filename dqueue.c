@@ -0,0 +1,362 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "dqueue.h"
+#include "common.h"
+
+
+/*--------------- INTERNAL FUNCTIONS ---------------*/
+ptrdiff_t _emi_dqueue_position(Dqueue *dqueue, ptrdiff_t index) {
+    /* where the element at index actually is in the buffer */
+    return (dqueue->head + index) & (dqueue->max_size - 1);
+}
+
+char *_emi_dqueue_slot(Dqueue *dqueue, ptrdiff_t index) {
+    return dqueue->data + _emi_dqueue_position(dqueue, index) * dqueue->data_size;
+}
+
+ptrdiff_t _emi_dqueue_powerOfTwo(ptrdiff_t size) {
+    /* -1 if there is no power of two that big */
+    ptrdiff_t power = 1;
+    while(power < size) {
+        if(power > PTRDIFF_MAX / 2) return -1;
+        power *= 2;
+    }
+    return power;
+}
+
+
+int _emi_dqueue_grow(Dqueue *dqueue, ptrdiff_t goal_size) {
+    /* grows the dqueue either by the growth exponential, or to be large
+    enough to fit in the new size, rounded up to a power of two. If -1
+    is provided for the new size, the dqueue is forced to grow.
+    0 is returned in case of success, 1 in case of failure */
+    if (goal_size <= dqueue->max_size && goal_size != -1) {
+        return 0;
+    }
+
+    ptrdiff_t old_max_size = dqueue->max_size;
+    ptrdiff_t new_max_size = old_max_size * dqueue->growth_exponential;
+    if(new_max_size < goal_size) new_max_size = goal_size;
+    new_max_size = _emi_dqueue_powerOfTwo(new_max_size);
+    if(new_max_size != -1 && new_max_size <= old_max_size) new_max_size = old_max_size * 2; /* for growth exponentials that are barely above 1 */
+
+    size_t new_bytes;
+    if(new_max_size == -1 || _common_checkedBytes(new_max_size, dqueue->data_size, &new_bytes) == 1) {
+        printf("%td elements of %d bytes is too much for a dqueue\n", goal_size, dqueue->data_size);
+        return 1;
+    }
+    char *new_location = (char*) realloc (dqueue->data, new_bytes);
+    if(new_location == NULL) {
+        printf("reallocation failed. tried to give %zu bytes, also, goal was %td elements\n", new_bytes, goal_size);
+        return 1;
+    }
+    dqueue->data = new_location;
+    dqueue->max_size = new_max_size;
+
+    /* if the elements wrapped around, the part from the head to the old
+    end gets moved to the new end, so they are in one piece again */
+    if(dqueue->head + dqueue->size > old_max_size) {
+        ptrdiff_t front_length = old_max_size - dqueue->head;
+        ptrdiff_t new_head     = new_max_size - front_length;
+        memmove(dqueue->data + new_head * dqueue->data_size, dqueue->data + dqueue->head * dqueue->data_size, (size_t) front_length * dqueue->data_size);
+        dqueue->head = new_head;
+    }
+
+    return 0;
+}
+
+
+void _emi_dqueue_copyIn(Dqueue *dqueue, ptrdiff_t index, char *data, ptrdiff_t count) {
+    /* copies count elements to index and onwards, which takes at most two
+    memcpys: up to the end of the buffer, and the rest from the start */
+    ptrdiff_t position = _emi_dqueue_position(dqueue, index);
+    ptrdiff_t first    = dqueue->max_size - position;
+    if(first > count) first = count;
+    memcpy(dqueue->data + position * dqueue->data_size, data, (size_t) first * dqueue->data_size);
+    memcpy(dqueue->data, data + first * dqueue->data_size, (size_t) (count - first) * dqueue->data_size);
+}
+
+void _emi_dqueue_copyOut(Dqueue *dqueue, ptrdiff_t index, char *output, ptrdiff_t count) {
+    ptrdiff_t position = _emi_dqueue_position(dqueue, index);
+    ptrdiff_t first    = dqueue->max_size - position;
+    if(first > count) first = count;
+    memcpy(output, dqueue->data + position * dqueue->data_size, (size_t) first * dqueue->data_size);
+    memcpy(output + first * dqueue->data_size, dqueue->data, (size_t) (count - first) * dqueue->data_size);
+}
+
+
+
+
+
+
+
+/*--------------- CREATION FUNCTIONS ---------------*/
+Dqueue *emi_dqueue_create(int data_size, int data_type) {
+    return emi_dqueue_createWithParas(data_size, data_type, DEFAULT_INITIAL_SIZE, DEFAULT_GROWTH_EXPONENTIAL);
+}
+
+
+Dqueue *emi_dqueue_createWithParas(int data_size, int data_type, ptrdiff_t initial_size, float growth_exponential) {
+    ptrdiff_t max_size = _emi_dqueue_powerOfTwo(initial_size);
+    size_t bytes;
+    if(max_size == -1 || _common_checkedBytes(max_size, data_size, &bytes) == 1) {
+        printf("can't make a dqueue with room for %td elements of %d bytes\n", initial_size, data_size);
+        return NULL;
+    }
+    Dqueue *new_dqueue = (Dqueue*) malloc (sizeof(Dqueue));
+    char *data = (char*) malloc (bytes);
+    if(new_dqueue == NULL || data == NULL) {
+        printf("malloc failed in emi_dqueue_create :(\n");
+        free(new_dqueue);
+        free(data);
+        return NULL;
+    }
+
+    new_dqueue->data_size          = data_size;
+    new_dqueue->data_type          = data_type;
+    new_dqueue->size               = 0;
+    new_dqueue->max_size           = max_size;
+    new_dqueue->growth_exponential = growth_exponential;
+    new_dqueue->head               = 0;
+    new_dqueue->data               = data;
+
+    return new_dqueue;
+}
+
+
+Dqueue *emi_dqueue_createFromArray(void *data, ptrdiff_t array_length, int data_size, int data_type) {
+    Dqueue *new_dqueue = emi_dqueue_createWithParas(data_size, data_type, array_length, DEFAULT_GROWTH_EXPONENTIAL);
+    if(new_dqueue == NULL) return NULL;
+    emi_dqueue_pushBackArray(new_dqueue, data, array_length);
+    return new_dqueue;
+}
+
+
+Dqueue *emi_dqueue_createCopy(Dqueue *original) {
+    /* the copy starts at the beginning of its buffer */
+    Dqueue *new_dqueue = emi_dqueue_createWithParas(original->data_size, original->data_type, original->max_size, original->growth_exponential);
+    if(new_dqueue == NULL) return NULL;
+    _emi_dqueue_copyOut(original, 0, new_dqueue->data, original->size);
+    new_dqueue->size = original->size;
+    return new_dqueue;
+}
+
+
+
+
+/*--------------- READING FUNCTIONS ---------------*/
+void *emi_dqueue_front(Dqueue *dqueue) {
+    if(dqueue->size == 0) {
+        printf("tried to read the front of an empty dqueue\n");
+        return NULL;
+    }
+    return _emi_dqueue_slot(dqueue, 0);
+}
+
+void *emi_dqueue_back(Dqueue *dqueue) {
+    if(dqueue->size == 0) {
+        printf("tried to read the back of an empty dqueue\n");
+        return NULL;
+    }
+    return _emi_dqueue_slot(dqueue, dqueue->size - 1);
+}
+
+void *emi_dqueue_readRaw(Dqueue *dqueue, ptrdiff_t index) {
+    if(dqueue->size == 0) {
+        printf("can't read from empty dqueue\n");
+        return NULL;
+    }
+    ptrdiff_t fixed_index = index;
+    _common_fixIndex(dqueue->size, &fixed_index);
+    return _emi_dqueue_slot(dqueue, fixed_index);
+}
+
+int emi_dqueue_readInto(Dqueue *dqueue, ptrdiff_t index, void *output) {
+    /* 0 is returned in case of success, 1 in case of failure */
+    char *item = emi_dqueue_readRaw(dqueue, index);
+    if(item == NULL) return 1;
+    memcpy(output, item, dqueue->data_size);
+    return 0;
+}
+
+
+
+
+/*--------------- PUSHING FUNCTIONS ---------------*/
+void emi_dqueue_pushFront(Dqueue *dqueue, void *data) {
+    if(_emi_dqueue_grow(dqueue, dqueue->size + 1) == 1) {
+        printf("can't push :(\n");
+        return;
+    }
+    dqueue->head = (dqueue->head - 1) & (dqueue->max_size - 1);
+    memcpy(dqueue->data + dqueue->head * dqueue->data_size, data, dqueue->data_size);
+    (dqueue->size)++;
+    return;
+}
+
+void emi_dqueue_pushBack(Dqueue *dqueue, void *data) {
+    if(_emi_dqueue_grow(dqueue, dqueue->size + 1) == 1) {
+        printf("can't push :(\n");
+        return;
+    }
+    memcpy(_emi_dqueue_slot(dqueue, dqueue->size), data, dqueue->data_size);
+    (dqueue->size)++;
+    return;
+}
+
+void emi_dqueue_pushFrontArray(Dqueue *dqueue, void *data, ptrdiff_t array_length) {
+    if(array_length <= 0) return;
+    if(_emi_dqueue_grow(dqueue, dqueue->size + array_length) == 1) {
+        printf("can't push :(\n");
+        return;
+    }
+    dqueue->head = (dqueue->head - array_length) & (dqueue->max_size - 1);
+    _emi_dqueue_copyIn(dqueue, 0, (char*) data, array_length);
+    dqueue->size += array_length;
+    return;
+}
+
+void emi_dqueue_pushBackArray(Dqueue *dqueue, void *data, ptrdiff_t array_length) {
+    if(array_length <= 0) return;
+    if(_emi_dqueue_grow(dqueue, dqueue->size + array_length) == 1) {
+        printf("can't push :(\n");
+        return;
+    }
+    _emi_dqueue_copyIn(dqueue, dqueue->size, (char*) data, array_length);
+    dqueue->size += array_length;
+    return;
+}
+
+
+
+
+/*--------------- POPPING FUNCTIONS ---------------*/
+void *emi_dqueue_popFront(Dqueue *dqueue) {
+    char *output = (char *) malloc (dqueue->data_size);
+    if(output == NULL) {
+        printf("malloc failed in emi_dqueue_popFront :(\n");
+        return NULL;
+    }
+    if(emi_dqueue_popFrontInto(dqueue, output) == 1) {
+        free(output);
+        return NULL;
+    }
+    return output;
+}
+
+void *emi_dqueue_popBack(Dqueue *dqueue) {
+    char *output = (char *) malloc (dqueue->data_size);
+    if(output == NULL) {
+        printf("malloc failed in emi_dqueue_popBack :(\n");
+        return NULL;
+    }
+    if(emi_dqueue_popBackInto(dqueue, output) == 1) {
+        free(output);
+        return NULL;
+    }
+    return output;
+}
+
+int emi_dqueue_popFrontInto(Dqueue *dqueue, void *output) {
+    /* 0 is returned in case of success, 1 in case of failure */
+    if(dqueue->size == 0) {
+        printf("can't pop from empty dqueue\n");
+        return 1;
+    }
+    memcpy(output, _emi_dqueue_slot(dqueue, 0), dqueue->data_size);
+    dqueue->head = _emi_dqueue_position(dqueue, 1);
+    (dqueue->size)--;
+    return 0;
+}
+
+int emi_dqueue_popBackInto(Dqueue *dqueue, void *output) {
+    /* 0 is returned in case of success, 1 in case of failure */
+    if(dqueue->size == 0) {
+        printf("can't pop from empty dqueue\n");
+        return 1;
+    }
+    memcpy(output, _emi_dqueue_slot(dqueue, dqueue->size - 1), dqueue->data_size);
+    (dqueue->size)--;
+    return 0;
+}
+
+ptrdiff_t emi_dqueue_popFrontArray(Dqueue *dqueue, void *output, ptrdiff_t array_length) {
+    /* pops up to array_length elements off the front, in order */
+    if(array_length > dqueue->size) array_length = dqueue->size;
+    if(array_length <= 0) return 0;
+    _emi_dqueue_copyOut(dqueue, 0, (char*) output, array_length);
+    dqueue->head = _emi_dqueue_position(dqueue, array_length);
+    dqueue->size -= array_length;
+    return array_length;
+}
+
+ptrdiff_t emi_dqueue_popBackArray(Dqueue *dqueue, void *output, ptrdiff_t array_length) {
+    /* pops up to array_length elements off the back. They're written in
+    the order they were in the dqueue, so the back one ends up last */
+    if(array_length > dqueue->size) array_length = dqueue->size;
+    if(array_length <= 0) return 0;
+    _emi_dqueue_copyOut(dqueue, dqueue->size - array_length, (char*) output, array_length);
+    dqueue->size -= array_length;
+    return array_length;
+}
+
+
+
+
+/*--------------- MODIFICATION FUNCTIONS ---------------*/
+void emi_dqueue_set(Dqueue *dqueue, void *data, ptrdiff_t index) {
+    char *item = emi_dqueue_readRaw(dqueue, index);
+    if(item == NULL) return;
+    memcpy(item, data, dqueue->data_size);
+    return;
+}
+
+
+
+
+// /*--------------- METADATA FUNCTIONS ---------------*/
+ptrdiff_t emi_dqueue_size(Dqueue *dqueue) {
+    return dqueue->size;
+}
+int emi_dqueue_dataSize(Dqueue *dqueue) {
+    return dqueue->data_size;
+}
+bool emi_dqueue_isEmpty(Dqueue *dqueue) {
+    return dqueue->size == 0;
+}
+
+
+void emi_dqueue_print(Dqueue *dqueue) {
+    if(dqueue->data_type == DATA_TYPE_DEF) {
+        printf("can't print default data type\n");
+        return;
+    }
+
+    printf("{");
+    for(ptrdiff_t i=0; i<dqueue->size; i++) {
+        _common_printData(_emi_dqueue_slot(dqueue, i), dqueue->data_size, dqueue->data_type);
+        if(i < dqueue->size - 1) {
+            printf(", ");
+        }
+    }
+    printf("}\n");
+    return;
+}
+
+
+
+// /*--------------- CLEANING FUNCTIONS ---------------*/
+void emi_dqueue_clear(Dqueue *dqueue) {
+    dqueue->size = 0;
+    dqueue->head = 0;
+    return;
+}
+
+void emi_dqueue_free(Dqueue *dqueue) {
+    free(dqueue->data);
+    free(dqueue);
+    return;
+}
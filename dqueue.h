@@ -0,0 +1,87 @@
+/* dynamically allocated double ended queue library
+
+  ____
+ /    \
+| _  _ |
+|      |
+ \    /
+  \  /
+   \/
+
+
+
+it's a ring buffer, so pushing and popping at both ends is O(1), and
+the size is always a power of two, so wrapping around is just a mask
+*/
+
+
+
+#ifndef DQUEUE_H
+#define DQUEUE_H
+
+
+#include <stdbool.h>
+#include "common.h"
+
+
+/*--------------- DEFINES ---------------*/
+#define DEFAULT_INITIAL_SIZE 16
+#define DEFAULT_GROWTH_EXPONENTIAL 2.0
+
+
+/*--------------- STRUCTS ---------------*/
+typedef struct Dqueue {
+    int data_size;
+    int data_type;
+    ptrdiff_t size;
+    ptrdiff_t max_size; /* always a power of two */
+    float growth_exponential;
+    ptrdiff_t head;     /* where the front element is */
+    char *data;
+} Dqueue;
+
+/*--------------- ENUMS ---------------*/
+
+
+
+
+/*--------------- CREATION FUNCTIONS ---------------*/
+Dqueue   *emi_dqueue_create          (int data_size, int data_type);
+Dqueue   *emi_dqueue_createWithParas (int data_size, int data_type, ptrdiff_t initial_size, float growth_exponential);
+Dqueue   *emi_dqueue_createFromArray (void *data, ptrdiff_t array_length, int data_size, int data_type);
+Dqueue   *emi_dqueue_createCopy      (Dqueue *original);
+
+/*--------------- READING FUNCTIONS ---------------*/
+void     *emi_dqueue_front    (Dqueue *dqueue); /* pointers into the dqueue */
+void     *emi_dqueue_back     (Dqueue *dqueue);
+void     *emi_dqueue_readRaw  (Dqueue *dqueue, ptrdiff_t index);
+int       emi_dqueue_readInto (Dqueue *dqueue, ptrdiff_t index, void *output);
+
+/*--------------- PUSHING FUNCTIONS ---------------*/
+void      emi_dqueue_pushFront      (Dqueue *dqueue, void *data);
+void      emi_dqueue_pushBack       (Dqueue *dqueue, void *data);
+void      emi_dqueue_pushFrontArray (Dqueue *dqueue, void *data, ptrdiff_t array_length); /* data[0] ends up in front */
+void      emi_dqueue_pushBackArray  (Dqueue *dqueue, void *data, ptrdiff_t array_length);
+
+/*--------------- POPPING FUNCTIONS ---------------*/
+void     *emi_dqueue_popFront      (Dqueue *dqueue);
+void     *emi_dqueue_popBack       (Dqueue *dqueue);
+int       emi_dqueue_popFrontInto  (Dqueue *dqueue, void *output); /* no malloc, returns 1 on failure */
+int       emi_dqueue_popBackInto   (Dqueue *dqueue, void *output);
+ptrdiff_t emi_dqueue_popFrontArray (Dqueue *dqueue, void *output, ptrdiff_t array_length); /* returns how many were popped */
+ptrdiff_t emi_dqueue_popBackArray  (Dqueue *dqueue, void *output, ptrdiff_t array_length); /* output is in queue order */
+
+/*--------------- MODIFICATION FUNCTIONS ---------------*/
+void      emi_dqueue_set (Dqueue *dqueue, void *data, ptrdiff_t index);
+
+/*--------------- UTILITY FUNCTIONS ---------------*/
+ptrdiff_t emi_dqueue_size     (Dqueue *dqueue);
+int       emi_dqueue_dataSize (Dqueue *dqueue);
+bool      emi_dqueue_isEmpty  (Dqueue *dqueue);
+void      emi_dqueue_print    (Dqueue *dqueue);
+
+/*--------------- MEMORY MANAGEMENT FUNCTIONS ---------------*/
+void      emi_dqueue_clear (Dqueue *dqueue);
+void      emi_dqueue_free  (Dqueue *dqueue);
+
+#endif
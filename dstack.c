@@ -7,8 +7,64 @@
 #include "common.h"
 
 
+/*--------------- STATS ---------------*/
+EmiStats _emi_dstack_global_stats;
+
+#define _EMI_DSTACK_NAME(name) #name,
+const char *_emi_dstack_function_names[] = { EMI_DSTACK_FUNCTIONS(_EMI_DSTACK_NAME) };
+
+_Static_assert(DSTACK_CALL_COUNT <= STATS_MAX_FUNCTIONS, "STATS_MAX_FUNCTIONS is too small for every dstack function");
+
+#ifdef EMI_STATS
+#define STATS_CALL(dstack, function) _common_statsCall((dstack)->stats, &_emi_dstack_global_stats, DSTACK_CALL_##function)
+#define STATS_CALL_GLOBAL(function) _common_statsCall(NULL, &_emi_dstack_global_stats, DSTACK_CALL_##function)
+#define STATS_RESIZE(dstack, old_max_size) _common_statsResize((dstack)->stats, &_emi_dstack_global_stats, old_max_size, (dstack)->max_size)
+#else
+#define STATS_CALL(dstack, function)
+#define STATS_CALL_GLOBAL(function)
+#define STATS_RESIZE(dstack, old_max_size) (void) (old_max_size)
+#endif
+
+
+
+
 /*--------------- INTERNAL FUNCTIONS ---------------*/
-int _emi_dstack_grow(Dstack *dstack, int goal_size) {
+int _emi_dstack_setCapacity(Dstack *dstack, ptrdiff_t new_max_size) {
+    /* the one place where the data gets resized.
+    0 is returned in case of success, 1 in case of failure */
+    size_t new_bytes;
+    if(_common_checkedBytes(new_max_size, dstack->data_size, &new_bytes) == 1) {
+        printf("%td elements of %d bytes is too much for a dstack\n", new_max_size, dstack->data_size);
+        return 1;
+    }
+    size_t old_bytes = (size_t) dstack->max_size * dstack->data_size;
+    bool is_inline = dstack->data == dstack->inline_data;
+
+    /* same as for the dlists, small data stays in the struct */
+    char *new_location;
+    if(new_bytes <= (size_t) dstack->inline_bytes) {
+        new_location = dstack->inline_data;
+        if(!is_inline) {
+            memcpy(new_location, dstack->data, (size_t) dstack->size * dstack->data_size);
+            _common_free(dstack->allocator, dstack->data, old_bytes);
+        }
+    } else if(is_inline) {
+        new_location = (char*) _common_alloc(dstack->allocator, new_bytes);
+        if(new_location == NULL) return 1;
+        memcpy(new_location, dstack->data, (size_t) dstack->size * dstack->data_size);
+    } else {
+        new_location = (char*) _common_realloc(dstack->allocator, dstack->data, old_bytes, new_bytes);
+        if(new_location == NULL) return 1;
+    }
+    ptrdiff_t old_max_size = dstack->max_size;
+    dstack->data = new_location;
+    dstack->max_size = new_max_size;
+    STATS_RESIZE(dstack, old_max_size);
+    return 0;
+}
+
+
+int _emi_dstack_grow(Dstack *dstack, ptrdiff_t goal_size) {
     /* grows the dstack either by the growth exponential,
     or to be large enough to fit in the new size. If -1 is
     provided for the new size, the dstack is forced to
@@ -18,44 +74,104 @@ int _emi_dstack_grow(Dstack *dstack, int goal_size) {
         return 0;
     }
 
-    int new_max_size = dstack->max_size * dstack->growth_exponential;
-    if(new_max_size < goal_size) new_max_size = goal_size;
+    ptrdiff_t new_max_size = _common_grownSize(dstack->max_size, dstack->growth_exponential, goal_size, dstack->data_size);
 
-    char *new_location = (char*) realloc (dstack->data, new_max_size * dstack->data_size);
-    if(new_location == NULL) {
-        printf("reallocation failed. tried to give %d bytes, also, goal was %d\n", new_max_size * dstack->data_size, goal_size * dstack->data_size);
+    if(_emi_dstack_setCapacity(dstack, new_max_size) == 1) {
+        printf("reallocation failed. tried to give room for %td elements, also, goal was %td\n", new_max_size, goal_size);
         return 1;
     }
-    dstack->data = new_location;
-    dstack->max_size = new_max_size;
 
     return 0;
 }
 
-int _emi_dstack_shrink(Dstack *dstack, int goal_size) {
-    /* I never actually use this in any of the functions,
-    but it's nice to have, I guess?? */
+int _emi_dstack_shrink(Dstack *dstack, ptrdiff_t goal_size) {
+    /* shrinks the dstack to goal_size, or by the growth exponential
+    if -1 is provided, but never below its size.
+    0 is returned in case of success, 1 in case of failure */
     if(goal_size > dstack->max_size) {
         return 0;
     }
     if(goal_size == -1) {
         goal_size = dstack->max_size / dstack->growth_exponential;
     }
-    if(goal_size < emi_dstack_size(dstack)) {
-        goal_size = emi_dstack_size(dstack);
+    if(goal_size < dstack->size) {
+        goal_size = dstack->size;
     }
 
-    char *new_location = (char*) realloc (dstack->data, goal_size * dstack->data_size);
-    if(new_location == NULL) {
-        printf("reallocation failed. tried to give %d bytes, also, goal was %d\n", goal_size * dstack->data_size, goal_size * dstack->data_size);
+    if(_emi_dstack_setCapacity(dstack, goal_size) == 1) {
+        printf("reallocation failed. tried to give room for %td elements\n", goal_size);
         return 1;
     }
-    dstack->data = new_location;
-    dstack->max_size = goal_size;
 
     return 0;
 }
 
+Dstack *_emi_dstack_create(int data_size, int data_type, ptrdiff_t initial_size, float growth_exponential, EmiAllocator *allocator) {
+    /* what all the create functions come down to. If it's at most
+    SMALL_BUFFER_BYTES, the data is put right after the struct */
+    size_t bytes;
+    if(_common_checkedBytes(initial_size, data_size, &bytes) == 1) {
+        printf("can't make a dstack with room for %td elements of %d bytes\n", initial_size, data_size);
+        return NULL;
+    }
+    size_t inline_bytes = bytes <= SMALL_BUFFER_BYTES ? bytes : 0;
+    bool needs_data = inline_bytes == 0 && bytes > 0;
+
+    Dstack *new_dstack = (Dstack*) _common_alloc(allocator, sizeof(Dstack) + inline_bytes);
+    char *data = needs_data && new_dstack != NULL ? (char*) _common_alloc(allocator, bytes) : NULL;
+    if(new_dstack == NULL || (needs_data && data == NULL)) {
+        printf("malloc failed in emi_dstack_create :(\n");
+        if(new_dstack != NULL) _common_free(allocator, new_dstack, sizeof(Dstack) + inline_bytes);
+        return NULL;
+    }
+
+    new_dstack->data_size          = data_size;
+    new_dstack->data_type          = data_type;
+    new_dstack->size               = 0;
+    new_dstack->max_size           = initial_size;
+    new_dstack->growth_exponential = growth_exponential;
+    new_dstack->auto_shrink        = false;
+    new_dstack->data               = needs_data ? data : new_dstack->inline_data;
+    new_dstack->inline_bytes       = (int) inline_bytes;
+    new_dstack->allocator          = allocator;
+    new_dstack->stats              = _common_statsCreate();
+    STATS_RESIZE(new_dstack, initial_size);
+
+    return new_dstack;
+}
+
+void _emi_dstack_free(Dstack *dstack) {
+    if(dstack->data != dstack->inline_data)
+        _common_free(dstack->allocator, dstack->data, (size_t) dstack->max_size * dstack->data_size);
+    free(dstack->stats);
+    _common_free(dstack->allocator, dstack, sizeof(Dstack) + dstack->inline_bytes);
+    return;
+}
+
+void _emi_dstack_pushArray(Dstack *dstack, void *data, ptrdiff_t array_length) {
+    if(_emi_dstack_grow(dstack, dstack->size + array_length) == 1) {
+        printf("can't extend :(\n");
+        return;
+    }
+    memcpy(dstack->data + dstack->size * dstack->data_size, data, (size_t) array_length * dstack->data_size);
+    dstack->size += array_length;
+    return;
+}
+
+void _emi_dstack_autoShrink(Dstack *dstack) {
+    /* same as for the dlists: only once the size is below
+    max_size / growth², and then to size * growth, so a stack that goes
+    up and down a bit doesn't keep reallocating */
+    if(!dstack->auto_shrink) return;
+    float growth = dstack->growth_exponential;
+    if(dstack->max_size <= DEFAULT_INITIAL_SIZE || dstack->size >= dstack->max_size / (growth * growth)) return;
+
+    ptrdiff_t goal_size = dstack->size * growth;
+    if(goal_size < DEFAULT_INITIAL_SIZE) goal_size = DEFAULT_INITIAL_SIZE;
+    _emi_dstack_shrink(dstack, goal_size);
+    return;
+}
+
 
 
 
@@ -63,77 +179,121 @@ int _emi_dstack_shrink(Dstack *dstack, int goal_size) {
 
 /*--------------- CREATION FUNCTIONS ---------------*/
 Dstack *emi_dstack_create(int data_size, int data_type) {
-    return emi_dstack_createWithParas(data_size, data_type, DEFAULT_INITIAL_SIZE, DEFAULT_GROWTH_EXPONENTIAL);
+    STATS_CALL_GLOBAL(create);
+    return _emi_dstack_create(data_size, data_type, DEFAULT_INITIAL_SIZE, DEFAULT_GROWTH_EXPONENTIAL, NULL);
 }
 
 
-Dstack *emi_dstack_createWithParas(int data_size, int data_type, int initial_size, float growth_exponential) {
-    Dstack *new_dstack = (Dstack*) malloc (sizeof(Dstack));
-    char *data = (char*) malloc (initial_size * data_size);
+Dstack *emi_dstack_createWithParas(int data_size, int data_type, ptrdiff_t initial_size, float growth_exponential) {
+    STATS_CALL_GLOBAL(createWithParas);
+    return _emi_dstack_create(data_size, data_type, initial_size, growth_exponential, NULL);
+}
 
-    new_dstack->data_size          = data_size;
-    new_dstack->data_type          = data_type;
-    new_dstack->size               = 0;
-    new_dstack->max_size           = initial_size;
-    new_dstack->growth_exponential = growth_exponential;
-    new_dstack->data               = data;
 
-    return new_dstack;
+Dstack *emi_dstack_createWithAllocator(int data_size, int data_type, ptrdiff_t initial_size, float growth_exponential, EmiAllocator *allocator) {
+    STATS_CALL_GLOBAL(createWithAllocator);
+    return _emi_dstack_create(data_size, data_type, initial_size, growth_exponential, allocator);
 }
 
 
-Dstack *emi_dstack_createFromArray (void *data, int array_length, int data_size, int data_type) {
-    Dstack *new_dstack = emi_dstack_createWithParas(data_size, data_type, data_size*DEFAULT_GROWTH_EXPONENTIAL, DEFAULT_GROWTH_EXPONENTIAL);
-    emi_dstack_pushArray(new_dstack, data, array_length);
+
+Dstack *emi_dstack_createFromArray (void *data, ptrdiff_t array_length, int data_size, int data_type) {
+    STATS_CALL_GLOBAL(createFromArray);
+    Dstack *new_dstack = _emi_dstack_create(data_size, data_type, data_size*DEFAULT_GROWTH_EXPONENTIAL, DEFAULT_GROWTH_EXPONENTIAL, NULL);
+    if(new_dstack != NULL) _emi_dstack_pushArray(new_dstack, data, array_length);
     return new_dstack;
 }
 
 
 Dstack *emi_dstack_createCopy(Dstack *original) {
-    Dstack *new_dstack = emi_dstack_createWithParas(original->data_size, original->data_type, original->max_size, original->growth_exponential);
+    STATS_CALL(original, createCopy);
+    Dstack *new_dstack = _emi_dstack_create(original->data_size, original->data_type, original->max_size, original->growth_exponential, original->allocator);
+    if(new_dstack == NULL) return NULL;
     new_dstack->size = original->size;
-    memcpy(new_dstack->data, original->data, original->size * original->data_size);
+    memcpy(new_dstack->data, original->data, (size_t) original->size * original->data_size);
     return new_dstack;
 }
 
 
 /*--------------- READING FUNCTIONS ---------------*/
-void *emi_dstack_peek(Dstack *dstack) {
-    if(emi_dstack_size(dstack) == 0) {
-        printf("can't read from empty dstack\n");
+/* like for the dlists, the internal versions that other functions
+use aren't counted in the stats */
+void *_emi_dstack_top(Dstack *dstack) {
+    if(dstack->size == 0) {
+        printf("tried to read the top of an empty stack\n");
         return NULL;
     }
-    char *top = emi_dstack_top(dstack);
-    if(top == NULL) return NULL;
+    return dstack->data + (dstack->size - 1) * dstack->data_size;
+}
 
-    char *output = (char *) malloc (dstack->data_size);
+int _emi_dstack_peekInto(Dstack *dstack, void *output) {
+    if(dstack->size == 0) {
+        printf("can't read from empty dstack\n");
+        return 1;
+    }
+    memcpy(output, _emi_dstack_top(dstack), dstack->data_size);
+    return 0;
+}
+
+int _emi_dstack_popInto(Dstack *dstack, void *output) {
+    char *top = _emi_dstack_top(dstack);
+    if(top == NULL) return 1;
     memcpy(output, top, dstack->data_size);
-    return output;
+    (dstack->size)--;
+    _emi_dstack_autoShrink(dstack);
+    return 0;
 }
 
-void *emi_dstack_top(Dstack *dstack) {
-    if(dstack->size == 0) {
-        printf("tried to read the top of an empty stack\n");
+void *emi_dstack_peek(Dstack *dstack) {
+    STATS_CALL(dstack, peek);
+    char *output = (char *) malloc (dstack->data_size);
+    if(output == NULL) {
+        printf("malloc failed in emi_dstack_peek :(\n");
         return NULL;
     }
-    return dstack->data + (dstack->size - 1) * dstack->data_size;
+    if(_emi_dstack_peekInto(dstack, output) == 1) {
+        free(output);
+        return NULL;
+    }
+    return output;
+}
+
+int emi_dstack_peekInto(Dstack *dstack, void *output) {
+    /* copies the top into output, which has to be at least data_size large.
+    0 is returned in case of success, 1 in case of failure */
+    STATS_CALL(dstack, peekInto);
+    return _emi_dstack_peekInto(dstack, output);
+}
+
+void *emi_dstack_top(Dstack *dstack) {
+    STATS_CALL(dstack, top);
+    return _emi_dstack_top(dstack);
 }
 
 void *emi_dstack_pop(Dstack *dstack) {
+    STATS_CALL(dstack, pop);
     char *output = (char *) malloc (dstack->data_size);
     if(output == NULL) {
         printf("malloc failed in emi_dstack_pop :(\n");
         return NULL;
     }
-    char *top = emi_dstack_top(dstack);
-    if(top == NULL) return NULL;
-    memcpy(output, top, dstack->data_size);
-    (dstack->size)--;
+    if(_emi_dstack_popInto(dstack, output) == 1) {
+        free(output);
+        return NULL;
+    }
     return output;
 }
 
+int emi_dstack_popInto(Dstack *dstack, void *output) {
+    /* 0 is returned in case of success, 1 in case of failure */
+    STATS_CALL(dstack, popInto);
+    return _emi_dstack_popInto(dstack, output);
+}
+
 void *emi_dstack_popRaw(Dstack *dstack) {
-    char *top = emi_dstack_top(dstack);
+    /* the pointer is into the dstack, so this one doesn't auto shrink */
+    STATS_CALL(dstack, popRaw);
+    char *top = _emi_dstack_top(dstack);
     if(top == NULL) return NULL;
     (dstack->size)--;
     return top;
@@ -141,31 +301,28 @@ void *emi_dstack_popRaw(Dstack *dstack) {
 
 void emi_dstack_popSilent(Dstack *dstack) {
     /* pops and doesn't return anything */
+    STATS_CALL(dstack, popSilent);
     (dstack->size)--;
+    _emi_dstack_autoShrink(dstack);
     return;
 }
 
 /*--------------- MODIFICATION FUNCTIONS ---------------*/
 void emi_dstack_push(Dstack *dstack, void *data) {
-    if(_emi_dstack_grow(dstack, emi_dstack_size(dstack) + 1) == 1) {
+    STATS_CALL(dstack, push);
+    if(_emi_dstack_grow(dstack, dstack->size + 1) == 1) {
         printf("can't append :(\n");
         return;
     }
     (dstack->size)++; /* we increment first, so it can't be an empty stack anymore */
-    char *top = emi_dstack_top(dstack);
+    char *top = _emi_dstack_top(dstack);
     memcpy(top, data, dstack->data_size);
     return;
 }
 
-void emi_dstack_pushArray(Dstack *dstack, void *data, int array_length) {
-    if(_emi_dstack_grow(dstack, emi_dstack_size(dstack) + array_length) == 1) {
-        printf("can't extend :(\n");
-        return;
-    }
-    (dstack->size)++; /* we increase by one already to make the top calculate from where on data has to be added */
-    char *top = emi_dstack_top(dstack); /* because of that incremeting, we also know the dstack is not empty, so no need to check that */
-    memcpy(top, data, array_length * dstack->data_size);
-    dstack->size += array_length - 1; /* minus one because we added one earlier */
+void emi_dstack_pushArray(Dstack *dstack, void *data, ptrdiff_t array_length) {
+    STATS_CALL(dstack, pushArray);
+    _emi_dstack_pushArray(dstack, data, array_length);
     return;
 }
 
@@ -176,15 +333,59 @@ void emi_dstack_pushArray(Dstack *dstack, void *data, int array_length) {
 
 
 
+/*--------------- SAVING FUNCTIONS ---------------*/
+int emi_dstack_save(Dstack *dstack, FILE *file) {
+    /* the bottom is saved first, so loading it pushes everything back in
+    the same order. 0 is returned in case of success, 1 in case of failure */
+    STATS_CALL(dstack, save);
+    return _common_save(file, dstack->data, dstack->size, dstack->data_size, dstack->data_type, dstack->growth_exponential);
+}
+
+int _emi_dstack_loadGrow(void *dstack, ptrdiff_t goal_size) {
+    /* how _common_loadData makes room in a dstack */
+    return _emi_dstack_grow((Dstack*) dstack, goal_size);
+}
+
+Dstack *emi_dstack_load(FILE *file) {
+    STATS_CALL_GLOBAL(load);
+    _CommonFileHeader header;
+    if(_common_loadHeader(file, &header, -1, -1) == 1) return NULL;
+
+    /* the size in the header isn't trusted, _common_loadData only grows
+    the dstack as the elements actually arrive */
+    ptrdiff_t initial_size = header.size < LOAD_CHUNK_SIZE ? header.size : LOAD_CHUNK_SIZE;
+    Dstack *new_dstack = _emi_dstack_create(header.data_size, header.data_type, initial_size > 0 ? initial_size : DEFAULT_INITIAL_SIZE, header.growth_exponential, NULL);
+    if(new_dstack == NULL) {
+        printf("malloc failed in emi_dstack_load :(\n");
+        return NULL;
+    }
+
+    if(_common_loadData(file, header.size, LOAD_CHUNK_SIZE, new_dstack->data_size, &new_dstack->data, &new_dstack->size, new_dstack, _emi_dstack_loadGrow) == 1) {
+        _emi_dstack_free(new_dstack);
+        return NULL;
+    }
+    return new_dstack;
+}
+
+
+
+
+
+
+
+
 // /*--------------- METADATA FUNCTIONS ---------------*/
-int emi_dstack_size(Dstack *dstack) {
+ptrdiff_t emi_dstack_size(Dstack *dstack) {
+    STATS_CALL(dstack, size);
     return dstack->size; /* x3 */
 }
 int emi_dstack_dataSize(Dstack *dstack) {
+    STATS_CALL(dstack, dataSize);
     return dstack->data_size;
 }
 
 bool emi_dstack_isEmpty(Dstack *dstack) {
+    STATS_CALL(dstack, isEmpty);
     return dstack->size == 0;
 }
 
@@ -192,15 +393,66 @@ bool emi_dstack_isEmpty(Dstack *dstack) {
 
 // /*--------------- CLEANING FUNCTIONS ---------------*/
 void emi_dstack_clear(Dstack *dstack) {
+    STATS_CALL(dstack, clear);
     dstack->size = 0;
+    _emi_dstack_autoShrink(dstack);
     return;
     /* heh~ */
 }
 
 void emi_dstack_free(Dstack *dstack) {
-    free(dstack->data);
-    free(dstack);
+    STATS_CALL(dstack, free);
+    _emi_dstack_free(dstack);
+    return;
+}
+
+int emi_dstack_reserve(Dstack *dstack, ptrdiff_t capacity) {
+    /* makes sure capacity elements fit without growing again. It never
+    shrinks, use emi_dstack_shrinkToFit for that.
+    0 is returned in case of success, 1 in case of failure */
+    STATS_CALL(dstack, reserve);
+    if(capacity <= dstack->max_size) return 0;
+    if(_emi_dstack_setCapacity(dstack, capacity) == 1) {
+        printf("can't reserve room for %td elements :(\n", capacity);
+        return 1;
+    }
+    return 0;
+}
+
+int emi_dstack_shrinkToFit(Dstack *dstack) {
+    /* 0 is returned in case of success, 1 in case of failure */
+    STATS_CALL(dstack, shrinkToFit);
+    ptrdiff_t goal_size = dstack->size > 0 ? dstack->size : 1;
+    if(goal_size == dstack->max_size) return 0;
+    return _emi_dstack_shrink(dstack, goal_size);
+}
+
+void emi_dstack_setAutoShrink(Dstack *dstack, bool auto_shrink) {
+    STATS_CALL(dstack, setAutoShrink);
+    dstack->auto_shrink = auto_shrink;
+    _emi_dstack_autoShrink(dstack);
     return;
 }
 
 
+
+
+/*--------------- STATS FUNCTIONS ---------------*/
+void emi_dstack_stats(Dstack *dstack, EmiStats *output) {
+    /* the stats are not counted for this one, so looking doesn't change them */
+    if(dstack == NULL) {
+        _common_statsCopy(&_emi_dstack_global_stats, output);
+    } else {
+        _common_statsCopy(dstack->stats, output);
+    }
+    return;
+}
+
+void emi_dstack_dumpStats(Dstack *dstack) {
+    if(dstack == NULL) {
+        _common_statsPrint(&_emi_dstack_global_stats, "every dstack", _emi_dstack_function_names, DSTACK_CALL_COUNT);
+    } else {
+        _common_statsPrint(dstack->stats, "dstack", _emi_dstack_function_names, DSTACK_CALL_COUNT);
+    }
+    return;
+}
@@ -29,52 +29,116 @@ this whole library is basically a subset of my dstack
 /*--------------- DEFINES ---------------*/
 #define DEFAULT_INITIAL_SIZE 16
 #define DEFAULT_GROWTH_EXPONENTIAL 2.0
+#define SMALL_BUFFER_BYTES 128 /* dstacks that start with at most this much room keep it inside the struct, 0 turns that off */
 
 
 /*--------------- STRUCTS ---------------*/
 typedef struct Dstack {
     int data_size;
     int data_type;
-    int size;
-    int max_size;
+    ptrdiff_t size;
+    ptrdiff_t max_size;
     float growth_exponential;
+    bool auto_shrink; /* off unless turned on with emi_dstack_setAutoShrink */
     char *data;
+    EmiAllocator *allocator; /* where the struct and the data come from, NULL for malloc */
+    EmiStats *stats; /* NULL unless compiled with EMI_STATS */
+    int inline_bytes; /* how much fits in inline_data */
+    _Alignas(max_align_t) char inline_data[]; /* where the data is while it's small enough */
 } Dstack;
 
 /*--------------- ENUMS ---------------*/
+/* every function has a number, which is where it's counted in the stats */
+#define EMI_DSTACK_FUNCTIONS(X)                                                        \
+    X(create) X(createWithParas) X(createFromArray) X(createCopy) X(peek) X(peekInto)  \
+    X(top) X(pop) X(popInto) X(popRaw) X(popSilent) X(push)                            \
+    X(pushArray) X(save) X(load) X(size) X(dataSize) X(isEmpty)                        \
+    X(clear) X(free) X(reserve) X(shrinkToFit) X(setAutoShrink) X(createWithAllocator)
+
+#define _EMI_DSTACK_CALL(name) DSTACK_CALL_##name,
+typedef enum {
+    EMI_DSTACK_FUNCTIONS(_EMI_DSTACK_CALL)
+    DSTACK_CALL_COUNT
+} DstackCall;
 
 
 
 
 /*--------------- CREATION FUNCTIONS ---------------*/
 Dstack *emi_dstack_create          (int data_size, int data_type);
-Dstack *emi_dstack_createWithParas (int data_size, int data_type, int initial_size, float growth_exponential);
-Dstack *emi_dstack_createFromArray (void *data, int array_length, int data_size, int data_type);
+Dstack *emi_dstack_createWithParas (int data_size, int data_type, ptrdiff_t initial_size, float growth_exponential);
+Dstack *emi_dstack_createFromArray (void *data, ptrdiff_t array_length, int data_size, int data_type);
 Dstack *emi_dstack_createCopy      (Dstack *original);
+Dstack *emi_dstack_createWithAllocator (int data_size, int data_type, ptrdiff_t initial_size, float growth_exponential, EmiAllocator *allocator); /* copies get the same allocator, see alloc.h */
 
 /*--------------- PEEKING FUNCTIONS ---------------*/
 void   *emi_dstack_peek      (Dstack *dstack);
+int     emi_dstack_peekInto  (Dstack *dstack, void *output); /* no malloc, returns 1 on failure */
 void   *emi_dstack_top       (Dstack *dstack);
 
 /*--------------- POPPING FUNCTIONS ---------------*/
 void   *emi_dstack_pop       (Dstack *dstack);
+int     emi_dstack_popInto   (Dstack *dstack, void *output); /* no malloc, returns 1 on failure */
 void   *emi_dstack_popRaw    (Dstack *dstack);
 void    emi_dstack_popSilent (Dstack *dstack);
 
 /*--------------- PUSHING FUNCTIONS ---------------*/
 void    emi_dstack_push      (Dstack *dstack, void *data);
-void    emi_dstack_pushArray (Dstack *dstack, void *data, int array_length);
+void    emi_dstack_pushArray (Dstack *dstack, void *data, ptrdiff_t array_length);
+
 
+/*--------------- SAVING FUNCTIONS ---------------*/
+int     emi_dstack_save      (Dstack *dstack, FILE *file); /* same format as a saved dlist, returns 1 on failure */
+Dstack *emi_dstack_load      (FILE *file);
 
 /*--------------- UTILITY FUNCTIONS ---------------*/
-int     emi_dstack_size      (Dstack *dstack);
+ptrdiff_t emi_dstack_size    (Dstack *dstack);
 int     emi_dstack_dataSize  (Dstack *dstack);
 bool    emi_dstack_isEmpty   (Dstack *dstack);
 
 /*--------------- MEMORY MANAGEMENT FUNCTIONS ---------------*/
-void    emi_dstack_clear     (Dstack *dstack);
-void    emi_dstack_free      (Dstack *dstack);
-
+void    emi_dstack_clear         (Dstack *dstack);
+void    emi_dstack_free          (Dstack *dstack);
+int     emi_dstack_reserve       (Dstack *dstack, ptrdiff_t capacity); /* makes room for at least capacity elements */
+int     emi_dstack_shrinkToFit   (Dstack *dstack); /* gives back everything that isn't used */
+void    emi_dstack_setAutoShrink (Dstack *dstack, bool auto_shrink); /* shrink when size drops below max_size / growth² */
+
+/*--------------- STATS FUNCTIONS ---------------*/
+void    emi_dstack_stats     (Dstack *dstack, EmiStats *output); /* a NULL dstack gives the totals of every dstack */
+void    emi_dstack_dumpStats (Dstack *dstack); /* same here */
+
+/*--------------- INTERNAL FUNCTIONS ---------------*/
+int     _emi_dstack_grow     (Dstack *dstack, ptrdiff_t goal_size); /* only here for the typed dstacks */
+
+
+
+/*--------------- TYPED DSTACKS ---------------*/
+/* same idea as EMI_DLIST_DEFINE: EMI_DSTACK_DEFINE(ints, int) makes
+inlinable ints_push(Dstack*, int), ints_pop, ints_peek and so on, which
+work on a normal Dstack of ints. Popping or peeking an empty stack
+isn't checked */
+#define EMI_DSTACK_DEFINE(name, T)                                                  \
+static inline Dstack *name##_create(int data_type) {                                \
+    return emi_dstack_create(sizeof(T), data_type);                                 \
+}                                                                                   \
+static inline T *name##_view(Dstack *dstack) {                                      \
+    if(dstack->data_size != (int) sizeof(T)) return NULL;                           \
+    return (T*) dstack->data;                                                       \
+}                                                                                   \
+static inline ptrdiff_t name##_size(Dstack *dstack) {                               \
+    return dstack->size;                                                            \
+}                                                                                   \
+static inline void name##_push(Dstack *dstack, T value) {                           \
+    if(dstack->size == dstack->max_size && _emi_dstack_grow(dstack, dstack->size + 1) == 1) \
+        return;                                                                     \
+    ((T*) dstack->data)[dstack->size++] = value;                                    \
+}                                                                                   \
+static inline T name##_pop(Dstack *dstack) { /* doesn't auto shrink */              \
+    return ((T*) dstack->data)[--dstack->size];                                     \
+}                                                                                   \
+static inline T name##_peek(Dstack *dstack) {                                       \
+    return ((T*) dstack->data)[dstack->size - 1];                                   \
+}
 
 
 
@@ -0,0 +1,212 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include "pool.h"
+#include "common.h"
+
+
+/*--------------- INTERNAL FUNCTIONS ---------------*/
+uint64_t _emi_pool_pack(uint32_t start, uint32_t end) {
+    return (uint64_t) end << 32 | start;
+}
+
+bool _emi_pool_takeChunk(_EmiPoolRange *range, int *chunk) {
+    /* takes the first chunk of a range, false if it's empty */
+    uint64_t chunks = atomic_load_explicit(&range->chunks, memory_order_relaxed);
+    while(true) {
+        uint32_t start = (uint32_t) chunks, end = (uint32_t) (chunks >> 32);
+        if(start >= end) return false;
+        if(atomic_compare_exchange_weak_explicit(&range->chunks, &chunks, _emi_pool_pack(start + 1, end), memory_order_relaxed, memory_order_relaxed)) {
+            *chunk = start;
+            return true;
+        }
+    }
+}
+
+bool _emi_pool_steal(Pool *pool, int self) {
+    /* takes the back half of another range and makes it ours. A range
+    that got emptied never gets the same value again, because every chunk
+    is only handed out once, so the compare and swaps can't be fooled */
+    for(int i=1; i<pool->thread_count; i++) {
+        _EmiPoolRange *victim = &pool->ranges[(self + i) % pool->thread_count];
+        uint64_t chunks = atomic_load_explicit(&victim->chunks, memory_order_relaxed);
+        while(true) {
+            uint32_t start = (uint32_t) chunks, end = (uint32_t) (chunks >> 32);
+            if(start >= end) break;
+            uint32_t middle = end - (end - start + 1) / 2;
+            if(atomic_compare_exchange_weak_explicit(&victim->chunks, &chunks, _emi_pool_pack(start, middle), memory_order_relaxed, memory_order_relaxed)) {
+                atomic_store_explicit(&pool->ranges[self].chunks, _emi_pool_pack(middle, end), memory_order_relaxed);
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+void _emi_pool_work(Pool *pool, int self) {
+    int chunk;
+    do {
+        while(_emi_pool_takeChunk(&pool->ranges[self], &chunk))
+            pool->function(pool->context, chunk);
+    } while(_emi_pool_steal(pool, self));
+}
+
+
+typedef struct {
+    Pool *pool;
+    int self;
+} _EmiPoolWorker;
+
+void *_emi_pool_worker(void *argument) {
+    _EmiPoolWorker worker = *(_EmiPoolWorker*) argument;
+    free(argument);
+    Pool *pool = worker.pool;
+
+    long seen = 0;
+    while(true) {
+        pthread_mutex_lock(&pool->lock);
+        while(pool->generation == seen && !pool->stopping)
+            pthread_cond_wait(&pool->wake, &pool->lock);
+        if(pool->stopping) {
+            pthread_mutex_unlock(&pool->lock);
+            return NULL;
+        }
+        seen = pool->generation;
+        pthread_mutex_unlock(&pool->lock);
+
+        _emi_pool_work(pool, worker.self);
+
+        pthread_mutex_lock(&pool->lock);
+        if(--(pool->busy) == 0)
+            pthread_cond_signal(&pool->done);
+        pthread_mutex_unlock(&pool->lock);
+    }
+}
+
+
+void _emi_pool_run(Pool *pool, void (*function)(void *context, int chunk), void *context, int chunk_count) {
+    /* calls function once for every chunk from 0 up to chunk_count, spread
+    over the threads of the pool, and returns when they're all done */
+    if(pool == NULL || pool->thread_count == 1 || chunk_count <= 1) {
+        for(int i=0; i<chunk_count; i++)
+            function(context, i);
+        return;
+    }
+
+    pthread_mutex_lock(&pool->run_lock);
+    for(int i=0; i<pool->thread_count; i++) {
+        uint32_t start = (long) chunk_count * i       / pool->thread_count;
+        uint32_t end   = (long) chunk_count * (i + 1) / pool->thread_count;
+        atomic_store_explicit(&pool->ranges[i].chunks, _emi_pool_pack(start, end), memory_order_relaxed);
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->function = function;
+    pool->context  = context;
+    pool->busy     = pool->thread_count - 1;
+    (pool->generation)++;
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+
+    /* the calling thread has the last range */
+    _emi_pool_work(pool, pool->thread_count - 1);
+
+    pthread_mutex_lock(&pool->lock);
+    while(pool->busy > 0)
+        pthread_cond_wait(&pool->done, &pool->lock);
+    pthread_mutex_unlock(&pool->lock);
+    pthread_mutex_unlock(&pool->run_lock);
+    return;
+}
+
+
+
+
+
+
+
+
+/*--------------- CREATION FUNCTIONS ---------------*/
+Pool *emi_pool_create(int threads) {
+    if(threads < 1) threads = 1;
+
+    Pool *new_pool = (Pool*) malloc (sizeof(Pool));
+    if(new_pool == NULL) {
+        printf("malloc failed in emi_pool_create :(\n");
+        return NULL;
+    }
+    size_t ranges_size = (threads * sizeof(_EmiPoolRange) + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE;
+    new_pool->ranges  = (_EmiPoolRange*) aligned_alloc(CACHE_LINE_SIZE, ranges_size);
+    new_pool->threads = (pthread_t*) malloc (threads * sizeof(pthread_t));
+    if(new_pool->ranges == NULL || new_pool->threads == NULL) {
+        printf("malloc failed in emi_pool_create :(\n");
+        free(new_pool->ranges);
+        free(new_pool->threads);
+        free(new_pool);
+        return NULL;
+    }
+    for(int i=0; i<threads; i++)
+        atomic_init(&new_pool->ranges[i].chunks, 0);
+
+    pthread_mutex_init(&new_pool->run_lock, NULL);
+    pthread_mutex_init(&new_pool->lock, NULL);
+    pthread_cond_init(&new_pool->wake, NULL);
+    pthread_cond_init(&new_pool->done, NULL);
+    new_pool->generation = 0;
+    new_pool->busy       = 0;
+    new_pool->stopping   = false;
+    new_pool->function   = NULL;
+    new_pool->context    = NULL;
+
+    /* if a thread can't be made, the pool just has fewer of them */
+    new_pool->thread_count = 1;
+    for(int i=0; i<threads-1; i++) {
+        _EmiPoolWorker *worker = (_EmiPoolWorker*) malloc (sizeof(_EmiPoolWorker));
+        if(worker == NULL) break;
+        worker->pool = new_pool;
+        worker->self = i;
+        if(pthread_create(&new_pool->threads[i], NULL, _emi_pool_worker, worker) != 0) {
+            printf("couldn't make more than %d threads for the pool\n", i);
+            free(worker);
+            break;
+        }
+        (new_pool->thread_count)++;
+    }
+
+    return new_pool;
+}
+
+
+
+
+/*--------------- UTILITY FUNCTIONS ---------------*/
+int emi_pool_threads(Pool *pool) {
+    return pool->thread_count;
+}
+
+
+
+
+/*--------------- MEMORY MANAGEMENT FUNCTIONS ---------------*/
+void emi_pool_free(Pool *pool) {
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = true;
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+
+    for(int i=0; i<pool->thread_count-1; i++)
+        pthread_join(pool->threads[i], NULL);
+
+    pthread_mutex_destroy(&pool->run_lock);
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->wake);
+    pthread_cond_destroy(&pool->done);
+    free(pool->ranges);
+    free(pool->threads);
+    free(pool);
+    return;
+}
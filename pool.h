@@ -0,0 +1,81 @@
+/* thread pool library, a few threads that stay around, so the parallel
+functions don't have to make new ones every time they're called
+
+  ____
+ /    \
+| _  _ |
+|      |
+ \    /
+  \  /
+   \/
+
+
+
+a job is split into chunks, and every thread (the one that called too)
+starts with an equal range of them. It takes its chunks one by one from
+the front, and when it runs out, it steals half of what's left of
+another thread's range from the back. So if some chunks take longer,
+the threads that are done early help out.
+
+a pool runs one job at a time. If two threads give it a job at the
+same time, the second one waits. Jobs can't start other jobs on the
+same pool.
+*/
+
+
+
+#ifndef POOL_H
+#define POOL_H
+
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include "common.h"
+
+
+/*--------------- DEFINES ---------------*/
+#define POOL_CHUNKS_PER_THREAD 8 /* how many chunks the parallel functions make per thread, so there is something to steal */
+
+
+/*--------------- STRUCTS ---------------*/
+typedef struct _EmiPoolRange {
+    _Alignas(CACHE_LINE_SIZE) _Atomic uint64_t chunks; /* end << 32 | start of the chunks that are left */
+} _EmiPoolRange;
+
+typedef struct Pool {
+    int thread_count;  /* including the thread that gives it a job */
+    pthread_t *threads;
+    _EmiPoolRange *ranges;
+
+    pthread_mutex_t run_lock; /* held for the whole job, so there's only one at a time */
+    pthread_mutex_t lock;     /* for everything below */
+    pthread_cond_t wake;
+    pthread_cond_t done;
+    long generation;   /* goes up for every job, that's how the workers know there's a new one */
+    int busy;          /* workers that aren't done with the job yet */
+    bool stopping;
+
+    void (*function)(void *context, int chunk);
+    void *context;
+} Pool;
+
+/*--------------- ENUMS ---------------*/
+
+
+
+
+/*--------------- CREATION FUNCTIONS ---------------*/
+Pool   *emi_pool_create  (int threads); /* threads also counts the one calling, so 1 makes no new threads */
+
+/*--------------- UTILITY FUNCTIONS ---------------*/
+int     emi_pool_threads (Pool *pool);
+
+/*--------------- MEMORY MANAGEMENT FUNCTIONS ---------------*/
+void    emi_pool_free    (Pool *pool);
+
+/*--------------- INTERNAL FUNCTIONS ---------------*/
+void    _emi_pool_run    (Pool *pool, void (*function)(void *context, int chunk), void *context, int chunk_count); /* for the parallel functions of the other files. A NULL pool runs everything on this thread */
+
+#endif